@@ -0,0 +1,365 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+
+// 与test9.c中LOG_FORMAT_BINARY的记录格式保持一致
+#define BIN_REC_SESSION 1 // 会话开始：magic + version，模块id从此重新编号
+#define BIN_REC_MODULE 2  // 模块定义：uint16 id + 模块名
+#define BIN_REC_LOG 3     // 日志：int64 时间戳 + uint16 模块id + int64 纳秒数 + 内容(版本1为int32秒数)
+#define BIN_LOG_MAGIC 0x474f4c42u // "BLOG"
+#define BIN_LOG_VERSION 2
+#define BIN_REC_HDR_LEN 4
+#define MAX_MODULE_ID 65536
+#define MAX_RECORD_BODY_LEN 65535
+
+// 与test9.c中压缩流的格式保持一致：流头(magic + 窗口大小) + 帧(原文长度、压缩后长度、校验和、数据)
+#define LOG_LZ_MAGIC 0x315a4c42u // "BLZ1"
+#define LOG_LZ_FRAME_STORED 0x80000000u
+#define LOG_LZ_WINDOW (64 * 1024)
+#define LOG_LZ_MAX_FRAME_RAW_LEN (64 * 1024) // test9.c中暂存区的大小
+#define LOG_LZ_MAX_FRAME_LEN (LOG_LZ_MAX_FRAME_RAW_LEN + LOG_LZ_MAX_FRAME_RAW_LEN / 255 + 16)
+#define LOG_LZ_MIN_MATCH 4
+
+static char *g_module_names[MAX_MODULE_ID];
+static uint32_t g_log_version = BIN_LOG_VERSION; // 当前会话的记录版本
+static int g_time_precision = 0;                 // 耗时输出的小数位数：0秒，3毫秒，6微秒
+
+static void reset_module_names()
+{
+    for (int i = 0; i < MAX_MODULE_ID; i++)
+    {
+        free(g_module_names[i]);
+        g_module_names[i] = NULL;
+    }
+}
+
+// 将一条日志记录渲染为"[年月日时分秒][模块名][秒数]内容"
+static void decode_log_record(const unsigned char *body, uint16_t len, FILE *out)
+{
+    int64_t timestamp, elapsed_ns;
+    uint16_t id;
+    const size_t elapsed_len = g_log_version == 1 ? sizeof(int32_t) : sizeof(int64_t);
+    const size_t fixed_len = sizeof(timestamp) + sizeof(id) + elapsed_len;
+    if (len < fixed_len)
+    {
+        fprintf(stderr, "Malformed log record.\n");
+        return;
+    }
+    memcpy(&timestamp, body, sizeof(timestamp));
+    memcpy(&id, body + sizeof(timestamp), sizeof(id));
+    if (g_log_version == 1)
+    {
+        int32_t seconds;
+        memcpy(&seconds, body + sizeof(timestamp) + sizeof(id), sizeof(seconds));
+        elapsed_ns = (int64_t)seconds * 1000000000;
+    }
+    else
+    {
+        memcpy(&elapsed_ns, body + sizeof(timestamp) + sizeof(id), sizeof(elapsed_ns));
+    }
+
+    // 按精度截断到整数单位后输出，与test9.c的文本格式一致
+    char elapsed[32];
+    int64_t scale = 1;
+    for (int i = g_time_precision; i < 9; i++)
+    {
+        scale *= 10;
+    }
+    int64_t units = elapsed_ns / scale;
+    int64_t abs_units = units < 0 ? -units : units;
+    int64_t per_sec = 1000000000 / scale;
+    if (g_time_precision == 0)
+    {
+        snprintf(elapsed, sizeof(elapsed), "%lld", (long long)units);
+    }
+    else
+    {
+        snprintf(elapsed, sizeof(elapsed), "%s%lld.%0*lld", units < 0 ? "-" : "", (long long)(abs_units / per_sec),
+                 g_time_precision, (long long)(abs_units % per_sec));
+    }
+
+    char timestr[20];
+    struct tm tm_log;
+    time_t t = (time_t)timestamp;
+    strftime(timestr, sizeof(timestr), "%Y-%m-%d %H:%M:%S", localtime_r(&t, &tm_log));
+    fprintf(out, "[%s][%s][%s]%.*s\n", timestr, g_module_names[id] != NULL ? g_module_names[id] : "?",
+            elapsed, (int)(len - fixed_len), (const char *)body + fixed_len);
+}
+
+// 逐条解码，文件在记录中间被截断时输出已完整的部分后结束
+int decode_boot_log(FILE *in, FILE *out)
+{
+    static unsigned char body[MAX_RECORD_BODY_LEN];
+    unsigned char hdr[BIN_REC_HDR_LEN];
+    uint16_t type, len;
+
+    while (fread(hdr, 1, BIN_REC_HDR_LEN, in) == BIN_REC_HDR_LEN)
+    {
+        memcpy(&type, hdr, sizeof(type));
+        memcpy(&len, hdr + 2, sizeof(len));
+        if (fread(body, 1, len, in) != len)
+        {
+            fprintf(stderr, "Truncated record at end of file.\n");
+            return 0;
+        }
+        switch (type)
+        {
+        case BIN_REC_SESSION:
+        {
+            uint32_t session[2] = {0, 0};
+            memcpy(session, body, len < sizeof(session) ? len : sizeof(session));
+            if (session[0] != BIN_LOG_MAGIC || session[1] < 1 || session[1] > BIN_LOG_VERSION)
+            {
+                fprintf(stderr, "Unsupported log format.\n");
+                return -1;
+            }
+            g_log_version = session[1];
+            reset_module_names();
+            break;
+        }
+        case BIN_REC_MODULE:
+        {
+            uint16_t id;
+            if (len < sizeof(id))
+            {
+                fprintf(stderr, "Malformed module record.\n");
+                return -1;
+            }
+            memcpy(&id, body, sizeof(id));
+            free(g_module_names[id]);
+            g_module_names[id] = strndup((const char *)body + sizeof(id), len - sizeof(id));
+            break;
+        }
+        case BIN_REC_LOG:
+            decode_log_record(body, len, out);
+            break;
+        default:
+            fprintf(stderr, "Unknown record type %u.\n", type);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// 读取扩展长度：连续的255累加，直到一个小于255的字节
+static int read_lz_length(const unsigned char **ip, const unsigned char *iend, size_t *len)
+{
+    unsigned char b;
+    do
+    {
+        if (*ip >= iend)
+        {
+            return -1;
+        }
+        b = *(*ip)++;
+        *len += b;
+    } while (b == 255);
+    return 0;
+}
+
+// 解压一帧到hist[start, start + raw_len)，匹配可引用start之前的历史
+static int decode_lz_frame(const unsigned char *ip, size_t len, unsigned char *hist, size_t start, size_t raw_len)
+{
+    const unsigned char *iend = ip + len;
+    size_t op = start, oend = start + raw_len;
+    while (ip < iend)
+    {
+        unsigned char token = *ip++;
+        size_t lit_len = token >> 4;
+        if ((lit_len == 15 && read_lz_length(&ip, iend, &lit_len) != 0) || lit_len > (size_t)(iend - ip) ||
+            lit_len > oend - op)
+        {
+            return -1;
+        }
+        memcpy(hist + op, ip, lit_len);
+        ip += lit_len;
+        op += lit_len;
+        if (ip == iend)
+        {
+            break; // 最后一个序列只有字面量
+        }
+        if (iend - ip < 2)
+        {
+            return -1;
+        }
+        size_t dist = ip[0] | (size_t)ip[1] << 8;
+        ip += 2;
+        size_t match_len = token & 15;
+        if (match_len == 15 && read_lz_length(&ip, iend, &match_len) != 0)
+        {
+            return -1;
+        }
+        match_len += LOG_LZ_MIN_MATCH;
+        if (dist == 0 || dist > op || match_len > oend - op)
+        {
+            return -1;
+        }
+        // 逐字节复制，距离小于长度时(重复串)也正确
+        for (size_t i = 0; i < match_len; i++, op++)
+        {
+            hist[op] = hist[op - dist];
+        }
+    }
+    return op == oend ? 0 : -1;
+}
+
+// 逐帧解压，文件在帧中间被截断或最后一帧校验失败时输出已完整的帧后结束
+int decompress_boot_log(FILE *in, FILE *out)
+{
+    static unsigned char hist[LOG_LZ_WINDOW + LOG_LZ_MAX_FRAME_RAW_LEN];
+    static unsigned char payload[LOG_LZ_MAX_FRAME_LEN];
+    size_t hist_len = 0;
+    bool started = false;
+    uint32_t word;
+
+    while (fread(&word, sizeof(word), 1, in) == 1)
+    {
+        // 每次写线程启动(或日志分段)都从流头重新开始
+        if (word == LOG_LZ_MAGIC)
+        {
+            uint32_t window;
+            if (fread(&window, sizeof(window), 1, in) != 1)
+            {
+                break;
+            }
+            if (window > LOG_LZ_WINDOW)
+            {
+                fprintf(stderr, "Unsupported compression window.\n");
+                return -1;
+            }
+            hist_len = 0;
+            started = true;
+            continue;
+        }
+        if (!started)
+        {
+            fprintf(stderr, "Not a compressed boot log.\n");
+            return -1;
+        }
+        uint32_t frame_hdr[2]; // 压缩后长度、校验和
+        if (fread(frame_hdr, sizeof(frame_hdr), 1, in) != 1)
+        {
+            fprintf(stderr, "Truncated frame at end of file.\n");
+            return 0;
+        }
+        uint32_t raw_len = word;
+        size_t comp_len = frame_hdr[0] & ~LOG_LZ_FRAME_STORED;
+        if (raw_len > LOG_LZ_MAX_FRAME_RAW_LEN || comp_len > LOG_LZ_MAX_FRAME_LEN)
+        {
+            fprintf(stderr, "Malformed frame.\n");
+            return 0;
+        }
+        if (fread(payload, 1, comp_len, in) != comp_len)
+        {
+            fprintf(stderr, "Truncated frame at end of file.\n");
+            return 0;
+        }
+        uint32_t checksum = 2166136261u; // FNV-1a
+        for (size_t i = 0; i < comp_len; i++)
+        {
+            checksum = (checksum ^ payload[i]) * 16777619u;
+        }
+        if (checksum != frame_hdr[1])
+        {
+            fprintf(stderr, "Corrupted frame, decoding stopped.\n");
+            return 0;
+        }
+
+        if (hist_len > LOG_LZ_WINDOW)
+        {
+            memmove(hist, hist + hist_len - LOG_LZ_WINDOW, LOG_LZ_WINDOW);
+            hist_len = LOG_LZ_WINDOW;
+        }
+        if (frame_hdr[0] & LOG_LZ_FRAME_STORED)
+        {
+            if (comp_len != raw_len)
+            {
+                fprintf(stderr, "Malformed frame.\n");
+                return 0;
+            }
+            memcpy(hist + hist_len, payload, raw_len);
+        }
+        else if (decode_lz_frame(payload, comp_len, hist, hist_len, raw_len) != 0)
+        {
+            fprintf(stderr, "Malformed frame.\n");
+            return 0;
+        }
+        fwrite(hist + hist_len, 1, raw_len, out);
+        hist_len += raw_len;
+    }
+    return 0;
+}
+
+// 读取文件开头的4字节后回到原位置
+static uint32_t peek_word(FILE *in)
+{
+    uint32_t word = 0;
+    long pos = ftell(in);
+    if (fread(&word, sizeof(word), 1, in) != 1)
+    {
+        word = 0;
+    }
+    fseek(in, pos, SEEK_SET);
+    return word;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "Usage: %s <binary or compressed boot.log> [output file|-] [s|ms|us]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    if (argc > 3)
+    {
+        g_time_precision = strcmp(argv[3], "us") == 0 ? 6 : (strcmp(argv[3], "ms") == 0 ? 3 : 0);
+    }
+    FILE *in = fopen(argv[1], "rb");
+    FILE *out = argc > 2 && strcmp(argv[2], "-") != 0 ? fopen(argv[2], "w") : stdout;
+    if (in == NULL || out == NULL)
+    {
+        fprintf(stderr, "Failed to open files\n");
+        return EXIT_FAILURE;
+    }
+
+    // 压缩的日志先解压，内容是二进制记录时再解码，是文本时原样输出
+    int ret = 0;
+    if (peek_word(in) == LOG_LZ_MAGIC)
+    {
+        FILE *plain = tmpfile();
+        if (plain == NULL)
+        {
+            fprintf(stderr, "Failed to create temporary file\n");
+            return EXIT_FAILURE;
+        }
+        ret = decompress_boot_log(in, plain);
+        fclose(in);
+        rewind(plain);
+        in = plain;
+    }
+    uint16_t first_type = peek_word(in) & 0xffff;
+    if (ret == 0 && first_type == BIN_REC_SESSION)
+    {
+        ret = decode_boot_log(in, out);
+    }
+    else if (ret == 0)
+    {
+        char buf[4096];
+        size_t n;
+        while ((n = fread(buf, 1, sizeof(buf), in)) > 0)
+        {
+            fwrite(buf, 1, n, out);
+        }
+    }
+
+    fclose(in);
+    if (out != stdout)
+    {
+        fclose(out);
+    }
+    reset_module_names();
+    return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
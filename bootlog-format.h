@@ -0,0 +1,280 @@
+// test7.c和test8.c的BOOTLOG调用点共用：解析格式串，捕获原始参数，写文件时再逐段格式化
+#ifndef BOOTLOG_FORMAT_H
+#define BOOTLOG_FORMAT_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdarg.h>
+#include <string.h>
+
+#define BOOTLOG_MAX_ARGS 16     // 延迟格式化支持的最多转换说明数
+#define BOOTLOG_MAX_SEG_LEN 256 // 延迟格式化时格式串每段(含一个转换说明)的最大长度
+
+// 格式串解析状态
+#define BOOTLOG_FMT_UNPARSED 0
+#define BOOTLOG_FMT_LAZY 1         // 可以延迟格式化
+#define BOOTLOG_FMT_UNSUPPORTED -1 // 含%n、%m、位置参数、long double等，回退为立即格式化
+
+// 捕获的参数类型
+#define BOOTLOG_ARG_INT 0  // int及更短的整数、字符(%lc的wint_t提升后也按int保存)
+#define BOOTLOG_ARG_LONG 1 // l/ll/j/z/t修饰的整数，LP64下都按long long保存
+#define BOOTLOG_ARG_DOUBLE 2
+#define BOOTLOG_ARG_PTR 3
+#define BOOTLOG_ARG_STR 4 // 字符串内容拷贝到记录中
+
+#define BOOTLOG_STAR_WIDTH 1     // 宽度由参数给出
+#define BOOTLOG_STAR_PRECISION 2 // 精度由参数给出
+
+// 首次打印时解析格式串的结果，之后按此捕获和格式化参数
+typedef struct bootlog_fmt
+{
+    signed char state;                        // BOOTLOG_FMT_*
+    unsigned char arg_num;                    // 转换说明数
+    unsigned char types[BOOTLOG_MAX_ARGS];    // 每个转换说明的参数类型
+    unsigned char stars[BOOTLOG_MAX_ARGS];    // 每个转换说明的宽度、精度是否由参数给出
+    unsigned short seg_end[BOOTLOG_MAX_ARGS]; // 第i段(以第i个转换说明结尾)在格式串中的结束位置
+} bootlog_fmt_t;
+
+// 解析格式串，记下每个转换说明的参数类型和分段位置
+static void parse_bootlog_format(const char *format, bootlog_fmt_t *fmt)
+{
+    const char *p = format;
+    const char *seg_begin = format;
+    fmt->arg_num = 0;
+    fmt->state = BOOTLOG_FMT_UNSUPPORTED;
+    while ((p = strchr(p, '%')) != NULL)
+    {
+        p++;
+        if (*p == '%')
+        {
+            p++;
+            continue;
+        }
+        if (fmt->arg_num >= BOOTLOG_MAX_ARGS)
+        {
+            return;
+        }
+        unsigned char stars = 0;
+        int longs = 0, long_double = 0;
+        p += strspn(p, "-+ #0'");
+        if (*p == '*')
+        {
+            stars |= BOOTLOG_STAR_WIDTH;
+            p++;
+        }
+        else
+        {
+            p += strspn(p, "0123456789");
+        }
+        if (*p == '.')
+        {
+            p++;
+            if (*p == '*')
+            {
+                stars |= BOOTLOG_STAR_PRECISION;
+                p++;
+            }
+            else
+            {
+                p += strspn(p, "0123456789");
+            }
+        }
+        for (; *p != '\0' && strchr("hlLqjzt", *p) != NULL; p++)
+        {
+            longs += *p != 'h' && *p != 'L';
+            long_double |= *p == 'L';
+        }
+        unsigned char type;
+        switch (*p)
+        {
+        case 'd':
+        case 'i':
+        case 'u':
+        case 'o':
+        case 'x':
+        case 'X':
+            type = longs > 0 ? BOOTLOG_ARG_LONG : BOOTLOG_ARG_INT;
+            break;
+        case 'c':
+            // %c传int，%lc传wint_t，两者都不宽于int，不看长度修饰
+            type = BOOTLOG_ARG_INT;
+            break;
+        case 'e':
+        case 'E':
+        case 'f':
+        case 'F':
+        case 'g':
+        case 'G':
+        case 'a':
+        case 'A':
+            if (long_double)
+            {
+                return;
+            }
+            type = BOOTLOG_ARG_DOUBLE;
+            break;
+        case 's':
+            if (longs > 0)
+            {
+                return;
+            }
+            type = BOOTLOG_ARG_STR;
+            break;
+        case 'p':
+            type = BOOTLOG_ARG_PTR;
+            break;
+        default:
+            return; // %n、%m、位置参数(%1$d)等
+        }
+        p++;
+        if (p - seg_begin >= BOOTLOG_MAX_SEG_LEN || p - format > 0xffff)
+        {
+            return;
+        }
+        fmt->types[fmt->arg_num] = type;
+        fmt->stars[fmt->arg_num] = stars;
+        fmt->seg_end[fmt->arg_num] = p - format;
+        fmt->arg_num++;
+        seg_begin = p;
+    }
+    fmt->state = BOOTLOG_FMT_LAZY;
+}
+
+// 按解析结果从可变参数中取出原始参数写入dst，字符串拷贝内容；空间不足返回-1
+static int capture_bootlog_args(const bootlog_fmt_t *fmt, char *dst, size_t size, va_list args)
+{
+    char *p = dst, *end = dst + size;
+#define CAPTURE_ARG(type)                     \
+    do                                        \
+    {                                         \
+        type v_ = va_arg(args, type);         \
+        if ((size_t)(end - p) < sizeof(v_))   \
+        {                                     \
+            return -1;                        \
+        }                                     \
+        memcpy(p, &v_, sizeof(v_));           \
+        p += sizeof(v_);                      \
+    } while (0)
+    for (int i = 0; i < fmt->arg_num; i++)
+    {
+        if (fmt->stars[i] & BOOTLOG_STAR_WIDTH)
+        {
+            CAPTURE_ARG(int);
+        }
+        if (fmt->stars[i] & BOOTLOG_STAR_PRECISION)
+        {
+            CAPTURE_ARG(int);
+        }
+        switch (fmt->types[i])
+        {
+        case BOOTLOG_ARG_INT:
+            CAPTURE_ARG(int);
+            break;
+        case BOOTLOG_ARG_LONG:
+            CAPTURE_ARG(long long);
+            break;
+        case BOOTLOG_ARG_DOUBLE:
+            CAPTURE_ARG(double);
+            break;
+        case BOOTLOG_ARG_PTR:
+            CAPTURE_ARG(void *);
+            break;
+        case BOOTLOG_ARG_STR:
+        {
+            // 字符串须完整放入记录，截断后再格式化可能与立即格式化的结果不同
+            const char *str = va_arg(args, const char *);
+            if (str == NULL)
+            {
+                str = "(null)";
+            }
+            size_t len = strnlen(str, end - p);
+            if (len == (size_t)(end - p))
+            {
+                return -1;
+            }
+            memcpy(p, str, len);
+            p[len] = '\0';
+            p += len + 1;
+            break;
+        }
+        }
+    }
+#undef CAPTURE_ARG
+    return p - dst;
+}
+
+// 按格式串逐段格式化记录中的原始参数，结果与vsnprintf(dst, size, format, ...)相同，返回写入的长度
+static size_t render_bootlog_args(const char *format, const bootlog_fmt_t *fmt, const char *args, char *dst,
+                                  size_t size)
+{
+    char seg[BOOTLOG_MAX_SEG_LEN];
+    size_t len = 0, pos = 0;
+#define RENDER_ARG(type)                                                                                  \
+    do                                                                                                    \
+    {                                                                                                     \
+        type v_;                                                                                          \
+        memcpy(&v_, args, sizeof(v_));                                                                    \
+        args += sizeof(v_);                                                                               \
+        n = stars == 0 ? snprintf(dst + len, size - len, seg, v_)                                         \
+            : stars == (BOOTLOG_STAR_WIDTH | BOOTLOG_STAR_PRECISION)                                      \
+                ? snprintf(dst + len, size - len, seg, width, precision, v_)                              \
+                : snprintf(dst + len, size - len, seg, stars == BOOTLOG_STAR_WIDTH ? width : precision, v_); \
+    } while (0)
+    for (int i = 0; i < fmt->arg_num && len + 1 < size; i++)
+    {
+        int stars = fmt->stars[i], width = 0, precision = 0, n = 0;
+        memcpy(seg, format + pos, fmt->seg_end[i] - pos);
+        seg[fmt->seg_end[i] - pos] = '\0';
+        pos = fmt->seg_end[i];
+        if (stars & BOOTLOG_STAR_WIDTH)
+        {
+            memcpy(&width, args, sizeof(width));
+            args += sizeof(width);
+        }
+        if (stars & BOOTLOG_STAR_PRECISION)
+        {
+            memcpy(&precision, args, sizeof(precision));
+            args += sizeof(precision);
+        }
+        switch (fmt->types[i])
+        {
+        case BOOTLOG_ARG_INT:
+            RENDER_ARG(int);
+            break;
+        case BOOTLOG_ARG_LONG:
+            RENDER_ARG(long long);
+            break;
+        case BOOTLOG_ARG_DOUBLE:
+            RENDER_ARG(double);
+            break;
+        case BOOTLOG_ARG_PTR:
+            RENDER_ARG(void *);
+            break;
+        case BOOTLOG_ARG_STR:
+            n = stars == 0 ? snprintf(dst + len, size - len, seg, args)
+                : stars == (BOOTLOG_STAR_WIDTH | BOOTLOG_STAR_PRECISION)
+                    ? snprintf(dst + len, size - len, seg, width, precision, args)
+                    : snprintf(dst + len, size - len, seg, stars == BOOTLOG_STAR_WIDTH ? width : precision, args);
+            args += strlen(args) + 1;
+            break;
+        }
+        if (n > 0)
+        {
+            len = len + n < size - 1 ? len + n : size - 1;
+        }
+    }
+#undef RENDER_ARG
+    // 最后一个转换说明之后的文字，只需把%%还原为%
+    for (const char *p = format + pos; *p != '\0' && len + 1 < size; p++)
+    {
+        dst[len++] = *p;
+        if (p[0] == '%' && p[1] == '%')
+        {
+            p++;
+        }
+    }
+    dst[len] = '\0';
+    return len;
+}
+
+#endif
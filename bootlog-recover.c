@@ -0,0 +1,215 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// 与test9.c中持久环形缓冲区文件的布局保持一致
+#define LOG_RING_MAGIC 0x474e5242u // "BRNG"
+#define LOG_RING_VERSION 1
+#define LOG_RING_STATE_ACTIVE 1
+#define LOG_RING_STATE_CLEAN 2
+#define LOG_RECORD_PAD 0x80000000u
+#define LOG_RECORD_BUSY 0x40000000u
+#define LOG_RECORD_ALIGN 8
+#define MAX_MODULE_ID 65536
+
+typedef struct ring_header
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t state;
+    uint32_t record_hdr_len;
+    int32_t pid;
+    uint32_t reserved;
+    uint64_t capacity;
+    uint64_t module_area_off;
+    uint64_t module_area_len;
+    uint64_t arena_off;
+    uint64_t module_area_used;
+    uint64_t read_index;
+    uint64_t write_index;
+} ring_header_t;
+
+typedef struct ring_module
+{
+    int64_t first_log_ns;
+    uint16_t id;
+    uint16_t name_len;
+    char name[];
+} ring_module_t;
+
+// 记录头，module字段是写日志进程中的指针，此处不使用
+typedef struct ring_record
+{
+    uint32_t size;
+    uint16_t log_len;
+    uint16_t module_id;
+    int64_t timestamp;
+    uint64_t module;
+    int64_t mono_ns;
+    char log_content[];
+} ring_record_t;
+
+static const ring_module_t *g_modules[MAX_MODULE_ID];
+static int g_time_precision = 0; // 耗时输出的小数位数：0秒，3毫秒，6微秒
+
+// 按精度截断到整数单位，与test9.c的文本格式一致
+static void format_elapsed(char *dst, size_t len, int64_t ns)
+{
+    int64_t scale = 1;
+    for (int i = g_time_precision; i < 9; i++)
+    {
+        scale *= 10;
+    }
+    int64_t units = ns / scale;
+    int64_t abs_units = units < 0 ? -units : units;
+    int64_t per_sec = 1000000000 / scale;
+    if (g_time_precision == 0)
+    {
+        snprintf(dst, len, "%lld", (long long)units);
+    }
+    else
+    {
+        snprintf(dst, len, "%s%lld.%0*lld", units < 0 ? "-" : "", (long long)(abs_units / per_sec),
+                 g_time_precision, (long long)(abs_units % per_sec));
+    }
+}
+
+// 读取模块名区，只取module_area_used之前已写完的模块项
+static void load_modules(const char *base, const ring_header_t *hdr)
+{
+    const char *p = base + hdr->module_area_off;
+    const char *end = p + (hdr->module_area_used < hdr->module_area_len ? hdr->module_area_used : hdr->module_area_len);
+    while (p + offsetof(ring_module_t, name) <= end)
+    {
+        const ring_module_t *m = (const ring_module_t *)p;
+        size_t size = (offsetof(ring_module_t, name) + m->name_len + 7) & ~(size_t)7;
+        if (p + offsetof(ring_module_t, name) + m->name_len > end)
+        {
+            break;
+        }
+        g_modules[m->id] = m;
+        p += size;
+    }
+}
+
+// 将一条已提交的记录渲染为"[年月日时分秒][模块名][秒数]内容"
+static void recover_record(const ring_record_t *e, FILE *out)
+{
+    const ring_module_t *m = g_modules[e->module_id];
+    char module_name[32];
+    int64_t elapsed_ns = 0;
+    if (m != NULL)
+    {
+        elapsed_ns = m->first_log_ns == 0 ? 0 : e->mono_ns - m->first_log_ns;
+    }
+    else
+    {
+        snprintf(module_name, sizeof(module_name), "#%u", e->module_id);
+    }
+
+    char elapsed[32];
+    format_elapsed(elapsed, sizeof(elapsed), elapsed_ns);
+    char timestr[20];
+    struct tm tm_log;
+    time_t t = (time_t)e->timestamp;
+    strftime(timestr, sizeof(timestr), "%Y-%m-%d %H:%M:%S", localtime_r(&t, &tm_log));
+    if (m != NULL)
+    {
+        fprintf(out, "[%s][%.*s][%s]%.*s\n", timestr, m->name_len, m->name, elapsed, e->log_len, e->log_content);
+    }
+    else
+    {
+        fprintf(out, "[%s][%s][%s]%.*s\n", timestr, module_name, elapsed, e->log_len, e->log_content);
+    }
+}
+
+// 从read_index扫描到write_index，输出尚未写入日志文件的已提交记录，跳过预留后未提交的记录
+int recover_log_ring(const char *base, size_t file_len, FILE *out)
+{
+    const ring_header_t *hdr = (const ring_header_t *)base;
+    if (file_len < sizeof(ring_header_t) || hdr->magic != LOG_RING_MAGIC || hdr->version != LOG_RING_VERSION ||
+        hdr->record_hdr_len != offsetof(ring_record_t, log_content) || hdr->arena_off + hdr->capacity > file_len ||
+        hdr->module_area_off + hdr->module_area_len > file_len || hdr->capacity == 0 ||
+        hdr->write_index - hdr->read_index > hdr->capacity)
+    {
+        fprintf(stderr, "Unsupported log ring file.\n");
+        return -1;
+    }
+    fprintf(stderr, "pid %d, %s, %llu bytes pending\n", hdr->pid,
+            hdr->state == LOG_RING_STATE_CLEAN ? "released cleanly" : "not released (crashed or still running)",
+            (unsigned long long)(hdr->write_index - hdr->read_index));
+    load_modules(base, hdr);
+
+    const char *arena = base + hdr->arena_off;
+    uint64_t pos = hdr->read_index;
+    size_t recovered = 0, uncommitted = 0;
+    while (pos < hdr->write_index)
+    {
+        size_t off = pos % hdr->capacity;
+        const ring_record_t *e = (const ring_record_t *)(arena + off);
+        uint32_t size = e->size & ~(LOG_RECORD_PAD | LOG_RECORD_BUSY);
+        // 预留后还没来得及标记的记录长度未知，之后的内容无法定位
+        if (size == 0 || size % LOG_RECORD_ALIGN != 0 || size > hdr->capacity - off)
+        {
+            fprintf(stderr, "Unreadable record at %llu, %llu bytes skipped.\n", (unsigned long long)pos,
+                    (unsigned long long)(hdr->write_index - pos));
+            break;
+        }
+        if (e->size & LOG_RECORD_BUSY)
+        {
+            uncommitted++;
+        }
+        else if (!(e->size & LOG_RECORD_PAD) && size >= hdr->record_hdr_len + e->log_len)
+        {
+            recover_record(e, out);
+            recovered++;
+        }
+        pos += size;
+    }
+    fprintf(stderr, "%zu records recovered, %zu uncommitted records skipped.\n", recovered, uncommitted);
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "Usage: %s <log ring file> [output file|-] [s|ms|us]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    if (argc > 3)
+    {
+        g_time_precision = strcmp(argv[3], "us") == 0 ? 6 : (strcmp(argv[3], "ms") == 0 ? 3 : 0);
+    }
+    int fd = open(argv[1], O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        fprintf(stderr, "Failed to open log ring file\n");
+        return EXIT_FAILURE;
+    }
+    const char *base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    FILE *out = argc > 2 && strcmp(argv[2], "-") != 0 ? fopen(argv[2], "w") : stdout;
+    if (base == MAP_FAILED || out == NULL)
+    {
+        fprintf(stderr, "Failed to open files\n");
+        return EXIT_FAILURE;
+    }
+
+    int ret = recover_log_ring(base, st.st_size, out);
+
+    if (out != stdout)
+    {
+        fclose(out);
+    }
+    munmap((void *)base, st.st_size);
+    return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,92 @@
+// 各日志实现的LOG_ALLOC_CHECK模式共用：替换malloc/calloc/realloc统计调用次数，
+// 证明init之后打印路径不再分配内存。只能被一个程序中的一个源文件包含
+#ifndef LOG_ALLOC_CHECK_H
+#define LOG_ALLOC_CHECK_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <pthread.h>
+
+#define ALLOC_CHECK_CALLS 1000000
+#define ALLOC_CHECK_MAX_THREADS 16
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+static unsigned long alloc_calls = 0;
+
+void *malloc(size_t size)
+{
+    __atomic_fetch_add(&alloc_calls, 1, __ATOMIC_RELAXED);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+    __atomic_fetch_add(&alloc_calls, 1, __ATOMIC_RELAXED);
+    return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    __atomic_fetch_add(&alloc_calls, 1, __ATOMIC_RELAXED);
+    return __libc_realloc(ptr, size);
+}
+
+// 打印一条日志，thread为线程序号，i为该线程内的序号
+typedef void (*alloc_check_log_fn)(int thread, int i);
+
+typedef struct alloc_check_worker
+{
+    alloc_check_log_fn log;
+    int thread;
+    int calls;
+    pthread_barrier_t *start;
+} alloc_check_worker_t;
+
+static void *alloc_check_producer(void *arg)
+{
+    alloc_check_worker_t *w = arg;
+    pthread_barrier_wait(w->start);
+    for (int i = 0; i < w->calls; i++)
+    {
+        w->log(w->thread, i);
+    }
+    return NULL;
+}
+
+// threads个线程共打印ALLOC_CHECK_CALLS条(含多次写文件)，flush非NULL时在统计结束前调用，
+// 统计期间的内存分配次数，非0时返回失败。调用前需完成日志的初始化
+static int run_alloc_check(int threads, alloc_check_log_fn log, void (*flush)(void))
+{
+    pthread_t tids[ALLOC_CHECK_MAX_THREADS];
+    alloc_check_worker_t workers[ALLOC_CHECK_MAX_THREADS];
+    pthread_barrier_t start;
+    if (threads < 1 || threads > ALLOC_CHECK_MAX_THREADS)
+    {
+        return 1;
+    }
+    pthread_barrier_init(&start, NULL, threads + 1);
+    for (int i = 0; i < threads; i++)
+    {
+        workers[i] = (alloc_check_worker_t){.log = log, .thread = i, .calls = ALLOC_CHECK_CALLS / threads, .start = &start};
+        pthread_create(&tids[i], NULL, alloc_check_producer, &workers[i]);
+    }
+    // 线程创建本身的分配不计入
+    unsigned long before = __atomic_load_n(&alloc_calls, __ATOMIC_RELAXED);
+    pthread_barrier_wait(&start);
+    for (int i = 0; i < threads; i++)
+    {
+        pthread_join(tids[i], NULL);
+    }
+    if (flush != NULL)
+    {
+        flush();
+    }
+    unsigned long allocs = __atomic_load_n(&alloc_calls, __ATOMIC_RELAXED) - before;
+    pthread_barrier_destroy(&start);
+    printf("%d log calls after init: %lu allocations\n", ALLOC_CHECK_CALLS, allocs);
+    return allocs == 0 ? 0 : 1;
+}
+
+#endif
@@ -0,0 +1,363 @@
+// 启动日志各实现的统一基准测试
+// 每次编译选择一个实现，直接包含其源文件并把它的main改名，由本文件通过其公开接口驱动：
+//   for v in 2 3 5 6 7 8 9; do gcc -O2 -DBENCH_VARIANT=$v logbench.c -o logbench$v -lpthread && ./logbench$v; done
+// 每个场景在单独的子进程中运行，峰值RSS和输出文件字节数互不影响；
+// 实现自身打印到stdout的内容被丢弃，结果经管道交给父进程输出
+// 每个场景结束后统计输出文件中的打印条数，少于打印次数(丢失或被实现丢弃)的结果标记为short；
+// test-2.c和test-5.c每个模块只保留最后一条打印，不做这项检查
+
+#define main variant_main
+#if BENCH_VARIANT == 2
+#include "test-2.c"
+#elif BENCH_VARIANT == 3
+#include "test-3.c"
+#elif BENCH_VARIANT == 5
+#include "test-5.c"
+#elif BENCH_VARIANT == 6
+#include "test6.c"
+#elif BENCH_VARIANT == 7
+#include "test7.c"
+#elif BENCH_VARIANT == 8
+#include "test8.c"
+#elif BENCH_VARIANT == 9
+#include "test9.c"
+#else
+#error "BENCH_VARIANT must be one of 2, 3, 5, 6, 7, 8, 9"
+#endif
+#undef main
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#ifndef BENCH_CALLS
+#define BENCH_CALLS 200000 // 每个场景的总打印次数
+#endif
+#define BENCH_POOL_SIZE 5000        // 各实现的链表池大小，自动写文件阈值取其一半
+#define BENCH_RING_BYTES (1 << 20)  // test9.c环形缓冲区字节数
+#define BENCH_MAX_MODULES 1000
+#define BENCH_MAX_THREADS 4
+#define BENCH_BURST_LEN 5000        // 突发场景每批的打印次数
+#define BENCH_BURST_GAP_US 10000    // 突发场景两批之间的空闲时间
+#define BENCH_OUTPUT_PATH "/tmp/logbench.log"
+#define BENCH_ENTRY_TEXT "boot log benchmark entry with a typical length of sixty bytes"
+#define BENCH_DEP_TEXT "bench_dep"
+
+// 各实现的初始化、打印和退出接口，test7.c和test8.c没有加锁，不参加多线程场景；
+// BENCH_KEEPS_ENTRIES为1表示每次打印都写入输出文件，可以按条数检查结果
+#if BENCH_VARIANT == 2
+#define BENCH_THREAD_SAFE 1
+#define BENCH_KEEPS_ENTRIES 0
+static void bench_init(const char *path) { init_log_pool(BENCH_POOL_SIZE, (char *)path); }
+static void bench_log(const char *mod, const char *dep, const char *text) { write_to_log((char *)mod, (char *)dep, (char *)text); }
+static void bench_finish() { release_log_pool(); }
+#elif BENCH_VARIANT == 3
+#define BENCH_THREAD_SAFE 1
+#define BENCH_KEEPS_ENTRIES 1
+static void bench_init(const char *path) { init_log_pool(BENCH_POOL_SIZE, path, BENCH_POOL_SIZE / 2); }
+static void bench_log(const char *mod, const char *dep, const char *text) { log_msg(mod, &dep, 1, "%s", text); }
+static void bench_finish()
+{
+    flush_to_file();
+    close_log_file();
+}
+#elif BENCH_VARIANT == 5
+#define BENCH_THREAD_SAFE 1
+#define BENCH_KEEPS_ENTRIES 0
+static void bench_init(const char *path) { init_log_pool(BENCH_POOL_SIZE, (char *)path); }
+static void bench_log(const char *mod, const char *dep, const char *text) { write_to_log((char *)mod, (char *)dep, (char *)text); }
+static void bench_finish() { release_log_pool(); }
+#elif BENCH_VARIANT == 6
+#define BENCH_THREAD_SAFE 1
+#define BENCH_KEEPS_ENTRIES 1
+static void bench_init(const char *path) { init(BENCH_MAX_MODULES, (char *)path); }
+static void bench_log(const char *mod, const char *dep, const char *text) { logMessage((char *)mod, (char *)dep, (char *)text); }
+static void bench_finish() { uninit(); }
+#elif BENCH_VARIANT == 7
+#define BENCH_THREAD_SAFE 0
+#define BENCH_KEEPS_ENTRIES 1
+static void bench_init(const char *path) { init_logger(BENCH_POOL_SIZE, path, BENCH_POOL_SIZE / 2); }
+static void bench_log(const char *mod, const char *dep, const char *text) { log_message(mod, dep, "%s", text); }
+static void bench_finish()
+{
+    print_module_info_to_file();
+    cleanup_logger();
+}
+#elif BENCH_VARIANT == 8
+#define BENCH_THREAD_SAFE 0
+#define BENCH_KEEPS_ENTRIES 1
+static void bench_init(const char *path) { init_boot_log(0, path, BENCH_POOL_SIZE / 2); }
+static void bench_log(const char *mod, const char *dep, const char *text) { module_boot_log(mod, dep, "%s", text); }
+static void bench_finish()
+{
+    flush_boot_log();
+    print_module_statistics();
+    release_boot_log();
+}
+#elif BENCH_VARIANT == 9
+#define BENCH_THREAD_SAFE 1
+#define BENCH_KEEPS_ENTRIES 1
+static void bench_init(const char *path)
+{
+    init_log_buffer(BENCH_RING_BYTES, path, BENCH_RING_BYTES / 2);
+    start_log_writer_thread();
+}
+static void bench_log(const char *mod, const char *dep, const char *text) { print_to_log_buffer(mod, dep, text); }
+static void bench_finish() { release_log_resources(); }
+#endif
+
+#define BENCH_STR(x) #x
+#define BENCH_XSTR(x) BENCH_STR(x)
+
+typedef struct bench_workload
+{
+    const char *name;
+    int threads;
+    int modules;
+    int burst_len; // 0表示连续打印
+} bench_workload_t;
+
+static const bench_workload_t g_bench_workloads[] = {
+    {"single", 1, 8, 0},
+    {"multi", BENCH_MAX_THREADS, 8, 0},
+    {"modules", 1, BENCH_MAX_MODULES, 0},
+    {"burst", 1, 8, BENCH_BURST_LEN},
+};
+
+// 子进程经管道交给父进程的结果
+typedef struct bench_result
+{
+    long calls;
+    double busy_ns;  // 打印阶段耗时，不含突发场景的空闲时间
+    double drain_ns; // 退出接口把剩余日志写完的耗时
+    uint32_t p50, p90, p99, p999, max;
+    long peak_rss_kb;
+    long long output_bytes;
+    long output_entries; // 输出文件中含BENCH_ENTRY_TEXT的行数，不检查时为-1
+} bench_result_t;
+
+typedef struct bench_thread_arg
+{
+    const bench_workload_t *workload;
+    int index;
+    int calls;
+    uint32_t *latency; // 每次调用的耗时(ns)
+    double idle_ns;
+} bench_thread_arg_t;
+
+static char g_bench_module_names[BENCH_MAX_MODULES][32];
+static pthread_barrier_t g_bench_barrier;
+
+static double bench_elapsed_ns(const struct timespec *beg, const struct timespec *end)
+{
+    return (end->tv_sec - beg->tv_sec) * 1e9 + (end->tv_nsec - beg->tv_nsec);
+}
+
+static void *bench_thread(void *arg)
+{
+    bench_thread_arg_t *t = (bench_thread_arg_t *)arg;
+    const bench_workload_t *w = t->workload;
+    struct timespec beg, end;
+
+    pthread_barrier_wait(&g_bench_barrier);
+    for (int i = 0; i < t->calls; i++)
+    {
+        const char *mod = g_bench_module_names[(i + t->index * 7) % w->modules];
+        clock_gettime(CLOCK_MONOTONIC, &beg);
+        bench_log(mod, BENCH_DEP_TEXT, BENCH_ENTRY_TEXT);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        double ns = bench_elapsed_ns(&beg, &end);
+        t->latency[i] = ns > UINT32_MAX ? UINT32_MAX : (uint32_t)ns;
+
+        if (w->burst_len > 0 && (i + 1) % w->burst_len == 0)
+        {
+            clock_gettime(CLOCK_MONOTONIC, &beg);
+            usleep(BENCH_BURST_GAP_US);
+            clock_gettime(CLOCK_MONOTONIC, &end);
+            t->idle_ns += bench_elapsed_ns(&beg, &end);
+        }
+    }
+    return NULL;
+}
+
+static int bench_cmp_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static uint32_t bench_percentile(const uint32_t *sorted, long n, double p)
+{
+    long i = (long)(p * (n - 1));
+    return sorted[i];
+}
+
+// 统计文件中含打印内容的行数，打开失败时返回-1
+static long bench_count_entries(const char *path)
+{
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL)
+    {
+        return -1;
+    }
+    char *line = NULL;
+    size_t cap = 0;
+    long entries = 0;
+    while (getline(&line, &cap, fp) != -1)
+    {
+        if (strstr(line, BENCH_ENTRY_TEXT) != NULL)
+        {
+            entries++;
+        }
+    }
+    free(line);
+    fclose(fp);
+    return entries;
+}
+
+// 在子进程中运行一个场景，返回值非0表示失败
+static int bench_run_workload(const bench_workload_t *w, bench_result_t *r)
+{
+    pthread_t tids[BENCH_MAX_THREADS];
+    bench_thread_arg_t args[BENCH_MAX_THREADS];
+    int per_thread = BENCH_CALLS / w->threads;
+    long calls = (long)per_thread * w->threads;
+    struct timespec beg, end;
+
+    // 耗时数组先写满一遍，各实现统计到的峰值RSS都包含这部分
+    uint32_t *latency = (uint32_t *)malloc(calls * sizeof(uint32_t));
+    if (latency == NULL)
+    {
+        return -1;
+    }
+    memset(latency, 0, calls * sizeof(uint32_t));
+
+    unlink(BENCH_OUTPUT_PATH);
+    bench_init(BENCH_OUTPUT_PATH);
+
+    pthread_barrier_init(&g_bench_barrier, NULL, w->threads + 1);
+    for (int i = 0; i < w->threads; i++)
+    {
+        args[i] = (bench_thread_arg_t){w, i, per_thread, latency + (long)i * per_thread, 0};
+        pthread_create(&tids[i], NULL, bench_thread, &args[i]);
+    }
+    pthread_barrier_wait(&g_bench_barrier);
+    clock_gettime(CLOCK_MONOTONIC, &beg);
+    double idle_ns = 0;
+    for (int i = 0; i < w->threads; i++)
+    {
+        pthread_join(tids[i], NULL);
+        idle_ns += args[i].idle_ns / w->threads;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    r->busy_ns = bench_elapsed_ns(&beg, &end) - idle_ns;
+    pthread_barrier_destroy(&g_bench_barrier);
+
+    clock_gettime(CLOCK_MONOTONIC, &beg);
+    bench_finish();
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    r->drain_ns = bench_elapsed_ns(&beg, &end);
+
+    qsort(latency, calls, sizeof(uint32_t), bench_cmp_u32);
+    r->calls = calls;
+    r->p50 = bench_percentile(latency, calls, 0.50);
+    r->p90 = bench_percentile(latency, calls, 0.90);
+    r->p99 = bench_percentile(latency, calls, 0.99);
+    r->p999 = bench_percentile(latency, calls, 0.999);
+    r->max = latency[calls - 1];
+    free(latency);
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    r->peak_rss_kb = usage.ru_maxrss;
+    struct stat st;
+    r->output_bytes = stat(BENCH_OUTPUT_PATH, &st) == 0 ? (long long)st.st_size : -1;
+    r->output_entries = BENCH_KEEPS_ENTRIES ? bench_count_entries(BENCH_OUTPUT_PATH) : -1;
+    return 0;
+}
+
+// fork出子进程运行场景并读取结果，子进程崩溃时返回-1
+static int bench_fork_workload(const bench_workload_t *w, bench_result_t *r)
+{
+    int fds[2];
+    if (pipe(fds) != 0)
+    {
+        return -1;
+    }
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+        close(fds[0]);
+        close(fds[1]);
+        return -1;
+    }
+    if (pid == 0)
+    {
+        int null_fd = open("/dev/null", O_WRONLY);
+        dup2(null_fd, STDOUT_FILENO);
+        close(fds[0]);
+        bench_result_t result;
+        memset(&result, 0, sizeof(result));
+        int ret = bench_run_workload(w, &result);
+        if (ret == 0 && write(fds[1], &result, sizeof(result)) != sizeof(result))
+        {
+            ret = -1;
+        }
+        _exit(ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+
+    close(fds[1]);
+    ssize_t n = read(fds[0], r, sizeof(*r));
+    close(fds[0]);
+    int status;
+    waitpid(pid, &status, 0);
+    if (n != sizeof(*r) || !WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS)
+    {
+        return -1;
+    }
+    return 0;
+}
+
+int main()
+{
+    for (int i = 0; i < BENCH_MAX_MODULES; i++)
+    {
+        snprintf(g_bench_module_names[i], sizeof(g_bench_module_names[i]), "module_%d", i);
+    }
+
+#if BENCH_VARIANT == 2 || BENCH_VARIANT == 3 || BENCH_VARIANT == 5
+    printf("variant: test-%d.c, %d calls per workload\n", BENCH_VARIANT, BENCH_CALLS);
+#else
+    printf("variant: test%d.c, %d calls per workload\n", BENCH_VARIANT, BENCH_CALLS);
+#endif
+    printf("%-9s%-9s%-12s%-8s%-8s%-8s%-9s%-10s%-10s%-10s%-14s%-10s\n", "workload", "threads", "calls/s",
+           "p50", "p90", "p99", "p99.9", "max ns", "drain ms", "rss KB", "output bytes", "entries");
+    for (size_t k = 0; k < sizeof(g_bench_workloads) / sizeof(g_bench_workloads[0]); k++)
+    {
+        const bench_workload_t *w = &g_bench_workloads[k];
+        bench_result_t r;
+        if (w->threads > 1 && !BENCH_THREAD_SAFE)
+        {
+            printf("%-9s%-9d%s\n", w->name, w->threads, "skipped, not thread-safe");
+            continue;
+        }
+        if (bench_fork_workload(w, &r) != 0)
+        {
+            printf("%-9s%-9d%s\n", w->name, w->threads, "failed");
+            continue;
+        }
+        printf("%-9s%-9d%-12.0f%-8u%-8u%-8u%-9u%-10u%-10.1f%-10ld%-14lld%-10ld%s\n", w->name, w->threads,
+               r.calls * 1e9 / r.busy_ns, r.p50, r.p90, r.p99, r.p999, r.max, r.drain_ns / 1e6,
+               r.peak_rss_kb, r.output_bytes, r.output_entries, BENCH_KEEPS_ENTRIES && r.output_entries < r.calls ? "short" : "");
+    }
+    return 0;
+}
@@ -6,23 +6,29 @@
 
 #define MAX_MODULE_NAME_LEN 32 // 模块名最大长度
 #define MAX_PRINT_MSG_LEN 512  // 打印消息最大长度
+#define LOG_NODE_SLAB_FACTOR 2 // 结点数为阈值的倍数，正在写文件的一批和正在积累的一批各占一份
+#define LOG_FILE_BUF_SIZE 4096
 
 typedef struct log_node_s
 {
     char mod_name[MAX_MODULE_NAME_LEN]; // 模块名
     char print_msg[MAX_PRINT_MSG_LEN];  // 打印消息内容
-    unsigned int beg_time;              // 第一条打印时间
-    unsigned int end_time;              // 最后一条打印时间
+    unsigned long long beg_ns;          // 第一条打印时间，单调时钟纳秒
+    unsigned long long end_ns;          // 最后一条打印时间，单调时钟纳秒
     struct log_node_s *next;            // 链表指针
 } log_node_t;
 
 typedef struct log_pool_s
 {
-    pthread_mutex_t pool_lock;  // 互斥锁，避免多线程并发问题
+    pthread_mutex_t pool_lock;  // 互斥锁，避免多线程并发问题；只保护链表，不在持锁时写文件
+    pthread_mutex_t flush_lock; // 串行化写文件，摘下的各批链表按摘下顺序写入
     unsigned int mod_num;       // 记录模块数量
     unsigned int print_num;     // 记录当前链表中打印数量
     unsigned int max_print_num; // 最大打印数量阈值
     log_node_t *head;           // 链表头结点
+    log_node_t *slab;           // init时一次性分配的全部结点，之后打印不再malloc
+    log_node_t *free_nodes;     // 空闲结点链表，由pool_lock保护
+    unsigned int drop_num;      // 结点耗尽时丢弃的打印数量
     FILE *fp;                   // 日志文件句柄
     char log_filename[256];     // 日志文件路径名
 } log_pool_t;
@@ -52,41 +58,111 @@ int init_log_pool(unsigned int pool_size, char *filename)
     }
     memset(g_mod_pool->head, 0, sizeof(log_node_t));
 
+    /* 一次性切分结点 */
+    unsigned int node_num = pool_size * LOG_NODE_SLAB_FACTOR;
+    g_mod_pool->slab = (log_node_t *)calloc(node_num, sizeof(log_node_t));
+    if (g_mod_pool->slab == NULL)
+    {
+        free(g_mod_pool->head);
+        free(g_mod_pool);
+        return -1;
+    }
+    for (unsigned int i = 0; i < node_num; i++)
+    {
+        g_mod_pool->slab[i].next = i + 1 < node_num ? &g_mod_pool->slab[i + 1] : NULL;
+    }
+    g_mod_pool->free_nodes = g_mod_pool->slab;
+
     pthread_mutex_init(&g_mod_pool->pool_lock, NULL);
+    pthread_mutex_init(&g_mod_pool->flush_lock, NULL);
     g_mod_pool->fp = fopen(g_mod_pool->log_filename, "a+");
     if (g_mod_pool->fp == NULL)
     {
+        free(g_mod_pool->slab);
         free(g_mod_pool->head);
         free(g_mod_pool);
         return -1;
     }
+    /* 使用静态缓冲区并提前加载时区，打印和写文件时不再分配内存 */
+    static char log_file_buf[LOG_FILE_BUF_SIZE];
+    setvbuf(g_mod_pool->fp, log_file_buf, _IOFBF, LOG_FILE_BUF_SIZE);
+    tzset();
 
     return 0;
 }
 
+/* 读取粗粒度实时时钟，走vDSO且不经过时区锁 */
+static time_t log_clock_now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME_COARSE, &ts);
+    return ts.tv_sec;
+}
+
+/* 读取单调时钟纳秒，模块耗时不受启动过程中NTP调整墙上时间的影响 */
+static unsigned long long log_mono_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* 按秒缓存格式化后的"年-月-日 时:分:秒"，每个线程各自缓存，同一秒内无需再调localtime_r */
+static const char *format_log_time(time_t t)
+{
+    static __thread time_t cached_time = -1;
+    static __thread char cached_timestr[20];
+    if (t != cached_time)
+    {
+        struct tm tm_now;
+        strftime(cached_timestr, sizeof(cached_timestr), "%Y-%m-%d %H:%M:%S", localtime_r(&t, &tm_now));
+        cached_time = t;
+    }
+    return cached_timestr;
+}
+
+/* 持锁时只调用：摘下当前链表并换上空链表，返回摘下的链表 */
+static log_node_t *swap_log_list()
+{
+    log_node_t *list = g_mod_pool->head->next;
+    g_mod_pool->head->next = NULL;
+    g_mod_pool->print_num = 0;
+    return list;
+}
+
+/* 将摘下的链表写入文件，不持有pool_lock；写完后持锁一次把整条链表归还空闲结点 */
+static void write_log_list(log_node_t *list, FILE *fp)
+{
+    log_node_t *last = NULL;
+    for (log_node_t *pos = list; pos != NULL; pos = pos->next)
+    {
+        fwrite(pos, 1, sizeof(log_node_t), fp);
+        last = pos;
+    }
+    fflush(fp);
+    if (last != NULL)
+    {
+        pthread_mutex_lock(&g_mod_pool->pool_lock);
+        last->next = g_mod_pool->free_nodes;
+        g_mod_pool->free_nodes = list;
+        pthread_mutex_unlock(&g_mod_pool->pool_lock);
+    }
+}
+
 /* 打印信息函数，传入参数str为需要写入日志的字符串 */
 void write_to_log(char *mod_name, char *dep_mod_names, char *str)
 {
-    log_node_t *node = NULL, *pos = NULL;
+    log_node_t *node = NULL, *pos = NULL, *full_list = NULL;
     char print_buff[MAX_PRINT_MSG_LEN + 128];
     time_t now;
-    struct tm tm_now;
-    unsigned int cur_sec;
-
-    /* 获取当前业务秒级别时间 */
-    now = time(NULL);
-    localtime_r(&now, &tm_now);
-    cur_sec = (unsigned int)now;
-
-    snprintf(print_buff, MAX_PRINT_MSG_LEN + 128, "[%04d-%02d-%02d %02d:%02d:%02d][%s][%s] %s\n",
-             tm_now.tm_year + 1900, tm_now.tm_mon + 1, tm_now.tm_mday,
-             tm_now.tm_hour, tm_now.tm_min, tm_now.tm_sec, mod_name, dep_mod_names, str);
+    unsigned long long cur_ns;
 
-    node = (log_node_t *)malloc(sizeof(log_node_t));
+    /* 墙上时间只用于打印前缀，模块首末打印时间取单调时钟 */
+    now = log_clock_now();
+    cur_ns = log_mono_ns();
 
-    node->beg_time = cur_sec;
-    node->end_time = cur_sec;
-    strncpy(node->print_msg, print_buff, MAX_PRINT_MSG_LEN);
+    snprintf(print_buff, MAX_PRINT_MSG_LEN + 128, "[%s][%s][%s] %s\n",
+             format_log_time(now), mod_name, dep_mod_names, str);
 
     pthread_mutex_lock(&g_mod_pool->pool_lock);
     pos = g_mod_pool->head;
@@ -94,65 +170,77 @@ void write_to_log(char *mod_name, char *dep_mod_names, char *str)
     {
         if (strncmp(pos->next->mod_name, mod_name, MAX_MODULE_NAME_LEN) == 0)
         {
-            /* 该模块已经存在，直接添加到链表尾部即可 */
-            pos->next->end_time = cur_sec;
-            strncpy(pos->next->print_msg, node->print_msg, MAX_PRINT_MSG_LEN);
-            free(node);
+            /* 该模块已经存在，更新该模块结点即可 */
+            pos->next->end_ns = cur_ns;
+            strncpy(pos->next->print_msg, print_buff, MAX_PRINT_MSG_LEN);
             break;
         }
         pos = pos->next;
     }
     if (pos->next == NULL)
     {
-        /* 该模块还不存在，需要新建模块结点 */
+        /* 该模块还不存在，从空闲结点中取一个新建模块结点 */
+        node = g_mod_pool->free_nodes;
+        if (node == NULL)
+        {
+            g_mod_pool->drop_num++;
+            pthread_mutex_unlock(&g_mod_pool->pool_lock);
+            return;
+        }
+        g_mod_pool->free_nodes = node->next;
+        node->next = NULL;
+        node->beg_ns = cur_ns;
+        node->end_ns = cur_ns;
+        strncpy(node->print_msg, print_buff, MAX_PRINT_MSG_LEN);
         strncpy(node->mod_name, mod_name, MAX_MODULE_NAME_LEN);
         pos->next = node;
         g_mod_pool->mod_num++;
     }
     g_mod_pool->print_num++;
-    /* 若链表中打印的数量达到阈值，则将链表中的所有结点写入到日志文件中 */
+    /* 若链表中打印的数量达到阈值，持锁只摘下链表，解锁后再写入日志文件 */
     if (g_mod_pool->print_num >= g_mod_pool->max_print_num)
     {
-        pos = g_mod_pool->head->next;
-        while (pos != NULL)
-        {
-            fwrite(pos, 1, sizeof(log_node_t), g_mod_pool->fp);
-            free(pos);
-            pos = pos->next;
-        }
-        g_mod_pool->head->next = NULL;
-        g_mod_pool->print_num = 0;
+        full_list = swap_log_list();
     }
     pthread_mutex_unlock(&g_mod_pool->pool_lock);
+
+    if (full_list != NULL)
+    {
+        pthread_mutex_lock(&g_mod_pool->flush_lock);
+        write_log_list(full_list, g_mod_pool->fp);
+        pthread_mutex_unlock(&g_mod_pool->flush_lock);
+    }
 }
 
-/* 将内存中的日志信息写入文件 */
+/* 将内存中的日志信息写入文件，filename为NULL时写入日志池的文件 */
 void dump_log(char *filename)
 {
-    log_node_t *pos = NULL;
+    log_node_t *list = NULL;
+    FILE *fp = NULL;
 
     if (g_mod_pool == NULL || g_mod_pool->head == NULL)
     {
         return;
     }
 
-    if (filename != NULL)
+    fp = filename != NULL ? fopen(filename, "a+") : g_mod_pool->fp;
+    if (fp == NULL)
     {
-        g_mod_pool->fp = fopen(filename, "a+");
+        return;
     }
-    
-    pos = g_mod_pool->head->next;
-    while (pos != NULL && pos->next != NULL)
+
+    pthread_mutex_lock(&g_mod_pool->pool_lock);
+    list = swap_log_list();
+    pthread_mutex_unlock(&g_mod_pool->pool_lock);
+
+    pthread_mutex_lock(&g_mod_pool->flush_lock);
+    write_log_list(list, fp);
+    pthread_mutex_unlock(&g_mod_pool->flush_lock);
+
+    if (fp != g_mod_pool->fp)
     {
-        fwrite(pos, 1, sizeof(log_node_t), g_mod_pool->fp);
-        pos = pos->next;
-        free(pos); // Move free to last step to avoid breaking traversal 
+        fclose(fp);
     }
-    
-    g_mod_pool->head->next = NULL;
-    g_mod_pool->print_num = 0;
-    
-    fclose(g_mod_pool->fp); // Close the pointer to file
 }
 
 
@@ -163,7 +251,30 @@ void release_log_pool()
     fclose(g_mod_pool->fp);
 
     pthread_mutex_destroy(&g_mod_pool->pool_lock);
+    pthread_mutex_destroy(&g_mod_pool->flush_lock);
+    free(g_mod_pool->slab);
     free(g_mod_pool->head);
     free(g_mod_pool);
 }
- 
\ No newline at end of file
+ 
+#ifdef LOG_ALLOC_CHECK
+#include "log-alloc-check.h"
+
+static void alloc_check_log(int thread, int i)
+{
+    char mod_name[MAX_MODULE_NAME_LEN];
+    snprintf(mod_name, sizeof(mod_name), "mod%d", thread);
+    write_to_log(mod_name, "dep", "allocation check line");
+}
+
+int main()
+{
+    if (init_log_pool(100, "/dev/null") != 0)
+    {
+        return 1;
+    }
+    int ret = run_alloc_check(4, alloc_check_log, NULL);
+    release_log_pool();
+    return ret;
+}
+#endif
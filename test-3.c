@@ -4,10 +4,19 @@
 #include <stdlib.h>
 #include <errno.h>
 #include <string.h>
+#include <time.h>
 
 #define MAX_LOG_MSG_SIZE 1024
 #define MAX_MODULE_NAME_LENGTH 32
 #define MAX_OTHER_MODULES 5
+#define LOG_MAGAZINE_SIZE 32 // 每个线程缓存的空闲元素数
+#define LOG_FILE_BUF_SIZE (64 * 1024) // 日志文件的stdio缓冲区，一批日志只需少量write
+
+// 打印级别，记录在调用点描述符中
+#define BOOTLOG_LEVEL_ERROR 0
+#define BOOTLOG_LEVEL_WARN 1
+#define BOOTLOG_LEVEL_INFO 2
+#define BOOTLOG_LEVEL_DEBUG 3
 
 typedef struct LogEntry
 {
@@ -32,9 +41,32 @@ static struct
     unsigned int count;
     element_t *head;
     element_t *tail;
-    pthread_mutex_t mutex;
+    unsigned int dropped;  // 日志池满时丢弃的条数，写文件时输出汇总后清零
+    pthread_mutex_t mutex; // 只保护链表和计数，不在持锁时写文件
+    pthread_mutex_t flush_mutex; // 串行化写文件，摘下的各批日志按摘下顺序写入
 } log_pool_stack = {0};
 
+// 元素在init时一次性从slab切分，之后分配和释放都不经过malloc/free
+// 全局仓库(depot)保存空闲元素，各线程的缓存(magazine)空了或满了才成批与仓库交换
+static struct
+{
+    element_t *slab;          // init时一次性分配的全部元素
+    element_t **depot;        // 空闲元素指针栈
+    unsigned int depot_count; // 仓库中的空闲元素数
+    pthread_mutex_t mutex;    // 保护仓库
+    pthread_key_t key;        // 线程退出时把缓存中的元素归还仓库
+    pthread_once_t key_once;
+} log_slab = {NULL, NULL, 0, PTHREAD_MUTEX_INITIALIZER, 0, PTHREAD_ONCE_INIT};
+
+typedef struct Magazine
+{
+    element_t *rounds[LOG_MAGAZINE_SIZE];
+    int count;
+    int registered; // 是否已登记线程退出时的归还
+} magazine_t;
+
+static __thread magazine_t thread_magazine;
+
 static const char *default_log_file_path = "./mylog.log";
 static unsigned int log_pool_size = 5000;
 static unsigned int flush_threshold = 2500;
@@ -44,10 +76,48 @@ void init_log_pool(unsigned int size, const char *file_path, unsigned int thresh
 
 element_t *allocate_element();
 void release_element(element_t *elem);
+void release_list(element_t *list);
 
 void log_msg(const char *module_name, const char **other_module_names,
              int other_module_count, const char *format, ...);
 
+void vlog_msg(const char *module_name, const char **other_module_names,
+              int other_module_count, const char *format, va_list ap);
+
+// BOOTLOG调用点描述符，bootlog_sites段的组织方式同test8.c
+typedef struct BootlogSite
+{
+    const char *module_name;
+    const char *format;
+    const char *file;
+    int line;
+    int level;
+    unsigned long count; // 该调用点的打印次数，多线程原子累加
+} bootlog_site_t;
+
+// 链接器为bootlog_sites段生成的起止地址，程序中没有调用点时为空
+extern bootlog_site_t *const __start_bootlog_sites[] __attribute__((weak));
+extern bootlog_site_t *const __stop_bootlog_sites[] __attribute__((weak));
+
+void bootlog_site_log(unsigned int site_id, ...);
+
+void print_bootlog_sites();
+
+// 按调用点打印，同test8.c的BOOTLOG_AT
+#define BOOTLOG_AT(lvl, mod, fmt, ...)                                                          \
+    do                                                                                          \
+    {                                                                                           \
+        static bootlog_site_t bootlog_site_ = {mod, fmt, __FILE__, __LINE__, lvl, 0};           \
+        static bootlog_site_t *const bootlog_site_ptr_                                          \
+            __attribute__((section("bootlog_sites"), used, aligned(sizeof(void *)))) = &bootlog_site_; \
+        if (0)                                                                                  \
+        {                                                                                       \
+            printf(fmt, ##__VA_ARGS__);                                                         \
+        }                                                                                       \
+        bootlog_site_log(&bootlog_site_ptr_ - __start_bootlog_sites, ##__VA_ARGS__);            \
+    } while (0)
+#define BOOTLOG(mod, fmt, ...) BOOTLOG_AT(BOOTLOG_LEVEL_INFO, mod, fmt, ##__VA_ARGS__)
+
 double time_interval(time_t t1, time_t t2);
 
 void start_commit_to_disk_thread();
@@ -56,8 +126,63 @@ void close_log_file();
 
 void flush_to_file();
 
+#ifdef LOG_ALLOC_CHECK
+#include "log-alloc-check.h"
+
+static void alloc_check_log(int thread, int i)
+{
+    log_msg("ALLOC_CHECK", NULL, 0, "allocation check line %d", i);
+}
+#endif
+
+#ifdef LOG_MAGAZINE_CHECK
+#define MAGAZINE_CHECK_POOL_SIZE 64
+#define MAGAZINE_CHECK_ROUNDS 100
+
+static void *magazine_check_flush(void *arg)
+{
+    flush_to_file();
+    return NULL;
+}
+
+// 每轮打印若干条后在新线程中写文件，线程退出后空闲元素数应回到池大小，否则说明有缓存未归还
+static int run_magazine_check()
+{
+    init_log_pool(MAGAZINE_CHECK_POOL_SIZE, "/dev/null", MAGAZINE_CHECK_POOL_SIZE);
+    for (int round = 0; round < MAGAZINE_CHECK_ROUNDS; round++)
+    {
+        for (int i = 0; i < MAGAZINE_CHECK_POOL_SIZE / 2; i++)
+        {
+            log_msg("MAGAZINE_CHECK", NULL, 0, "round %d line %d", round, i);
+        }
+        pthread_t tid;
+        pthread_create(&tid, NULL, magazine_check_flush, NULL);
+        pthread_join(tid, NULL);
+
+        pthread_mutex_lock(&log_slab.mutex);
+        unsigned int free_count = log_slab.depot_count + thread_magazine.count;
+        pthread_mutex_unlock(&log_slab.mutex);
+        if (free_count != MAGAZINE_CHECK_POOL_SIZE)
+        {
+            printf("round %d: %u of %d elements free\n", round, free_count, MAGAZINE_CHECK_POOL_SIZE);
+            return 1;
+        }
+    }
+    printf("%d flushes on short-lived threads: all %d elements returned\n", MAGAZINE_CHECK_ROUNDS,
+           MAGAZINE_CHECK_POOL_SIZE);
+    return 0;
+}
+#endif
+
 int main()
 {
+#ifdef LOG_ALLOC_CHECK
+    init_log_pool(log_pool_size, "/dev/null", flush_threshold);
+    return run_alloc_check(4, alloc_check_log, NULL);
+#endif
+#ifdef LOG_MAGAZINE_CHECK
+    return run_magazine_check();
+#endif
 
     printf("log test start...");
 
@@ -66,8 +191,10 @@ int main()
     start_commit_to_disk_thread();
 
     log_msg("MAIN", NULL, 0, "Hello, world!\n");
+    BOOTLOG("MAIN", "log pool size %u, flush threshold %u", log_pool_size, flush_threshold);
 
     flush_to_file();
+    print_bootlog_sites();
 
     return 0;
 }
@@ -85,6 +212,24 @@ void init_log_pool(unsigned int size, const char *file_path, unsigned int thresh
 
     flush_threshold = threshold;
 
+    log_slab.slab = (element_t *)calloc(size, sizeof(element_t));
+    log_slab.depot = (element_t **)malloc(size * sizeof(element_t *));
+    if (log_slab.slab == NULL || log_slab.depot == NULL)
+    {
+        printf("Failed to allocate log pool of %u elements.\n", size);
+        free(log_slab.slab);
+        free(log_slab.depot);
+        log_slab.slab = NULL;
+        log_slab.depot = NULL;
+        return;
+    }
+    for (unsigned int i = 0; i < size; i++)
+    {
+        log_slab.depot[i] = &log_slab.slab[i];
+    }
+    log_slab.depot_count = size;
+    tzset(); // 提前加载时区，写文件时localtime_r不再分配内存
+
     if (file_path == NULL)
     {
         file_path = default_log_file_path;
@@ -98,39 +243,88 @@ void init_log_pool(unsigned int size, const char *file_path, unsigned int thresh
         return;
     }
 
-    setvbuf(log_file, NULL, _IOLBF, 1024);
+    // 使用静态缓冲区，stdio不会在第一次写文件时分配；全缓冲，每批日志写完后由flush_to_file统一fflush
+    static char log_file_buf[LOG_FILE_BUF_SIZE];
+    setvbuf(log_file, log_file_buf, _IOFBF, LOG_FILE_BUF_SIZE);
 }
 
-// 从日志池中分配一个元素
-element_t *allocate_element()
+// 线程退出时把缓存中的元素归还仓库
+static void return_magazine(void *arg)
 {
-    element_t *elem;
-    if (log_pool_stack.head != NULL)
+    magazine_t *mag = (magazine_t *)arg;
+    pthread_mutex_lock(&log_slab.mutex);
+    while (mag->count > 0)
     {
-        elem = log_pool_stack.head;
-        log_pool_stack.head = elem->next;
+        log_slab.depot[log_slab.depot_count++] = mag->rounds[--mag->count];
     }
-    else
+    pthread_mutex_unlock(&log_slab.mutex);
+}
+
+static void create_magazine_key()
+{
+    pthread_key_create(&log_slab.key, return_magazine);
+}
+
+// 取本线程的缓存，首次使用时登记线程退出时的归还；只归还元素的线程(如写文件线程)同样需要登记
+static magazine_t *get_thread_magazine()
+{
+    magazine_t *mag = &thread_magazine;
+    if (!mag->registered)
     {
-        elem = (element_t *)malloc(sizeof(*elem));
-        elem->next = NULL;
+        pthread_once(&log_slab.key_once, create_magazine_key);
+        pthread_setspecific(log_slab.key, mag);
+        mag->registered = 1;
     }
+    return mag;
+}
+
+// 从日志池中分配一个元素：先取本线程缓存，缓存空了从仓库取半个缓存的量；池耗尽时返回NULL
+element_t *allocate_element()
+{
+    magazine_t *mag = get_thread_magazine();
+    if (mag->count == 0)
+    {
+        pthread_mutex_lock(&log_slab.mutex);
+        while (mag->count < LOG_MAGAZINE_SIZE / 2 && log_slab.depot_count > 0)
+        {
+            mag->rounds[mag->count++] = log_slab.depot[--log_slab.depot_count];
+        }
+        pthread_mutex_unlock(&log_slab.mutex);
+        if (mag->count == 0)
+        {
+            return NULL;
+        }
+    }
+    element_t *elem = mag->rounds[--mag->count];
+    elem->next = NULL;
     return elem;
 }
 
+// 归还元素：先放回本线程缓存，缓存满了把一半还给仓库，供其他线程取用
 void release_element(element_t *elem)
 {
-    elem->next = NULL;
+    magazine_t *mag = get_thread_magazine();
     memset(&elem->value, 0, sizeof(elem->value));
-    if (log_pool_stack.head == NULL)
+    if (mag->count == LOG_MAGAZINE_SIZE)
     {
-        log_pool_stack.head = elem;
-        log_pool_stack.tail = elem;
+        pthread_mutex_lock(&log_slab.mutex);
+        while (mag->count > LOG_MAGAZINE_SIZE / 2)
+        {
+            log_slab.depot[log_slab.depot_count++] = mag->rounds[--mag->count];
+        }
+        pthread_mutex_unlock(&log_slab.mutex);
     }
-    else
+    mag->rounds[mag->count++] = elem;
+}
+
+// 归还一整条已写入文件的链表
+void release_list(element_t *list)
+{
+    while (list != NULL)
     {
-        log_pool_stack.tail->next = elem;
-        log_pool_stack.tail = elem;
+        element_t *next = list->next;
+        release_element(list);
+        list = next;
     }
 }
 
@@ -138,53 +332,96 @@ void log_msg(const char *module_name, const char **other_module_names,
              int other_module_count, const char *format, ...)
 {
     va_list ap;
-    char msg[MAX_LOG_MSG_SIZE];
 
     va_start(ap, format);
-    vsnprintf(msg, MAX_LOG_MSG_SIZE, format, ap);
+    vlog_msg(module_name, other_module_names, other_module_count, format, ap);
     va_end(ap);
+}
 
-    pthread_mutex_lock(&log_pool_stack.mutex);
+// BOOTLOG宏的运行时入口，按下标取调用点描述符，计数为O(1)
+void bootlog_site_log(unsigned int site_id, ...)
+{
+    va_list ap;
+    bootlog_site_t *site = __start_bootlog_sites[site_id];
 
-    element_t *new_elem = allocate_element();
-    if (new_elem == NULL)
+    __atomic_fetch_add(&site->count, 1, __ATOMIC_RELAXED);
+    va_start(ap, site_id);
+    vlog_msg(site->module_name, NULL, 0, site->format, ap);
+    va_end(ap);
+}
+
+// 将各调用点的打印次数写入日志文件，未执行过的调用点也列出
+void print_bootlog_sites()
+{
+    static const char *level_names[] = {"ERROR", "WARN", "INFO", "DEBUG"};
+    if (log_file == NULL || __start_bootlog_sites == NULL)
     {
-        printf("Failed to allocate new log element.\n");
         return;
     }
+    pthread_mutex_lock(&log_pool_stack.flush_mutex);
+    for (bootlog_site_t *const *p = __start_bootlog_sites; p < __stop_bootlog_sites; p++)
+    {
+        const bootlog_site_t *site = *p;
+        fprintf(log_file, "[%ld][%s:%d][%s][%s][%lu]%s\n", (long)(p - __start_bootlog_sites), site->file, site->line,
+                site->module_name, level_names[site->level], __atomic_load_n(&site->count, __ATOMIC_RELAXED), site->format);
+    }
+    fflush(log_file);
+    pthread_mutex_unlock(&log_pool_stack.flush_mutex);
+}
+
+void vlog_msg(const char *module_name, const char **other_module_names,
+              int other_module_count, const char *format, va_list ap)
+{
+    char msg[MAX_LOG_MSG_SIZE];
 
-    new_elem->value.first_print_time = time(NULL);
-    strncpy(new_elem->value.module_name, module_name, MAX_MODULE_NAME_LENGTH - 1);
-    new_elem->value.module_name[MAX_MODULE_NAME_LENGTH - 1] = '\0';
-    new_elem->value.last_print_time = new_elem->value.first_print_time;
-    new_elem->value.other_module_count = other_module_count;
-    memcpy(new_elem->value.other_modules, other_module_names,
-           sizeof(char *) * other_module_count);
-    strncpy(new_elem->value.content, msg, MAX_LOG_MSG_SIZE - 1);
-    new_elem->value.content[MAX_LOG_MSG_SIZE - 1] = '\0';
+    vsnprintf(msg, MAX_LOG_MSG_SIZE, format, ap);
 
-    if (log_pool_stack.count == log_pool_stack.size)
+    // 分配和填充都在锁外完成，锁内只做计数检查和入队
+    element_t *new_elem = allocate_element();
+    if (new_elem != NULL)
     {
-        log_msg("LOG_POOL_OVERFLOW", NULL, 0, "");
+        new_elem->value.first_print_time = time(NULL);
+        strncpy(new_elem->value.module_name, module_name, MAX_MODULE_NAME_LENGTH - 1);
+        new_elem->value.module_name[MAX_MODULE_NAME_LENGTH - 1] = '\0';
+        new_elem->value.last_print_time = new_elem->value.first_print_time;
+        new_elem->value.other_module_count = other_module_count;
+        memcpy(new_elem->value.other_modules, other_module_names,
+               sizeof(char *) * other_module_count);
+        strncpy(new_elem->value.content, msg, MAX_LOG_MSG_SIZE - 1);
+        new_elem->value.content[MAX_LOG_MSG_SIZE - 1] = '\0';
     }
-    else
+
+    pthread_mutex_lock(&log_pool_stack.mutex);
+
+    // 日志池满(或元素已全部在用)时丢弃新日志并计数，不能在持锁时递归调用log_msg，否则会自锁
+    if (new_elem == NULL || log_pool_stack.count == log_pool_stack.size)
     {
-        if (log_pool_stack.head == NULL)
-        {
-            log_pool_stack.head = new_elem;
-            log_pool_stack.tail = new_elem;
-        }
-        else
+        log_pool_stack.dropped++;
+        pthread_mutex_unlock(&log_pool_stack.mutex);
+        if (new_elem != NULL)
         {
-            log_pool_stack.tail->next = new_elem;
-            log_pool_stack.tail = new_elem;
+            release_element(new_elem);
         }
-        log_pool_stack.count++;
+        flush_to_file();
+        return;
+    }
+
+    if (log_pool_stack.head == NULL)
+    {
+        log_pool_stack.head = new_elem;
+        log_pool_stack.tail = new_elem;
     }
+    else
+    {
+        log_pool_stack.tail->next = new_elem;
+        log_pool_stack.tail = new_elem;
+    }
+    log_pool_stack.count++;
+    int need_flush = log_pool_stack.count >= flush_threshold;
 
     pthread_mutex_unlock(&log_pool_stack.mutex);
 
-    if (log_pool_stack.count >= flush_threshold)
+    if (need_flush)
     {
         flush_to_file();
     }
@@ -196,24 +433,39 @@ void start_commit_to_disk_thread()
     pthread_create(&tid, NULL, (void *(*)(void *)) & flush_to_file, NULL);
 }
 
+// 持锁只摘下待写队列并换上空队列，写文件和归还元素都在锁外进行
 void flush_to_file()
 {
+    pthread_mutex_lock(&log_pool_stack.flush_mutex);
 
     pthread_mutex_lock(&log_pool_stack.mutex);
+    element_t *list = log_pool_stack.head;
+    unsigned int dropped = log_pool_stack.dropped;
+    log_pool_stack.head = NULL;
+    log_pool_stack.tail = NULL;
+    log_pool_stack.count = 0;
+    log_pool_stack.dropped = 0;
+    pthread_mutex_unlock(&log_pool_stack.mutex);
 
-    if (log_pool_stack.count == 0 || log_file == NULL)
+    if ((list == NULL && dropped == 0) || log_file == NULL)
     {
-        pthread_mutex_unlock(&log_pool_stack.mutex);
+        // 没有日志文件时丢弃摘下的日志，与原先不写文件直接返回的效果一致
+        pthread_mutex_unlock(&log_pool_stack.flush_mutex);
+        if (list != NULL)
+        {
+            release_list(list);
+        }
         return;
     }
 
-    element_t *element = log_pool_stack.head;
+    element_t *element = list;
     while (element != NULL)
     {
 
         char formatted_time[25];
+        struct tm tm_log;
         strftime(formatted_time, sizeof(formatted_time), "%F %T",
-                 localtime(&(element->value.first_print_time)));
+                 localtime_r(&(element->value.first_print_time), &tm_log));
 
         fprintf(log_file, "[%s][%s][%.2lf] %s\n",
                 formatted_time,
@@ -222,16 +474,25 @@ void flush_to_file()
                               element->value.last_print_time),
                 element->value.content);
 
-        fflush(log_file);
-
-        element_t *prev = element;
         element = element->next;
-        release_element(prev);
+    }
 
-        log_pool_stack.count--;
+    if (dropped > 0)
+    {
+        char formatted_time[25];
+        struct tm tm_now;
+        time_t now = time(NULL);
+        strftime(formatted_time, sizeof(formatted_time), "%F %T", localtime_r(&now, &tm_now));
+        fprintf(log_file, "[%s][LOG_POOL_OVERFLOW][0.00] %u entries dropped\n",
+                formatted_time, dropped);
     }
+    fflush(log_file);
+    pthread_mutex_unlock(&log_pool_stack.flush_mutex);
 
-    pthread_mutex_unlock(&log_pool_stack.mutex);
+    if (list != NULL)
+    {
+        release_list(list);
+    }
 }
 
 double time_interval(time_t t1, time_t t2)
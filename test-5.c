@@ -59,22 +59,38 @@ int init_log_pool(unsigned int pool_size, char *filename) {
     return 0;
 }
 
+/* 读取粗粒度实时时钟，走vDSO且不经过时区锁 */
+static time_t log_clock_now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME_COARSE, &ts);
+    return ts.tv_sec;
+}
+
+/* 按秒缓存格式化后的"年-月-日 时:分:秒"，每个线程各自缓存，同一秒内无需再调localtime_r */
+static const char *format_log_time(time_t t) {
+    static __thread time_t cached_time = -1;
+    static __thread char cached_timestr[20];
+    if (t != cached_time) {
+        struct tm tm_now;
+        strftime(cached_timestr, sizeof(cached_timestr), "%Y-%m-%d %H:%M:%S", localtime_r(&t, &tm_now));
+        cached_time = t;
+    }
+    return cached_timestr;
+}
+
 /* 打印信息函数，传入参数str为需要写入日志的字符串 */
 void write_to_log(char *mod_name, char *dep_mod_names, char *str) {
     log_node_t *node = NULL, *pos = NULL;
     char print_buff[MAX_PRINT_MSG_LEN + 128];
     time_t now;
-    struct tm tm_now;
     unsigned int cur_sec;
 
     /* 获取当前业务秒级别时间 */
-    now = time(NULL);
-    localtime_r(&now, &tm_now);
+    now = log_clock_now();
     cur_sec = (unsigned int)now;
 
-    snprintf(print_buff, MAX_PRINT_MSG_LEN + 128, "[%04d-%02d-%02d %02d:%02d:%02d][%s][%s] %s\n",
-             tm_now.tm_year + 1900, tm_now.tm_mon + 1, tm_now.tm_mday,
-             tm_now.tm_hour, tm_now.tm_min, tm_now.tm_sec, mod_name, dep_mod_names, str);
+    snprintf(print_buff, MAX_PRINT_MSG_LEN + 128, "[%s][%s][%s] %s\n",
+             format_log_time(now), mod_name, dep_mod_names, str);
 
     node = (log_node_t *)malloc(sizeof(log_node_t));
     if (node == NULL) {
@@ -82,6 +98,7 @@ void write_to_log(char *mod_name, char *dep_mod_names, char *str) {
         exit(-1);
     }
 
+    node->next = NULL;
     node->beg_time = cur_sec;
     node->end_time = cur_sec;
     strncpy(node->print_msg, print_buff, MAX_PRINT_MSG_LEN);
@@ -111,8 +128,8 @@ void write_to_log(char *mod_name, char *dep_mod_names, char *str) {
         while (pos != NULL) {
             fwrite(pos, 1, sizeof(log_node_t), g_mod_pool->fp);
             log_node_t *temp = pos;
-            free(temp);
             pos = pos->next;
+            free(temp);
         }
         g_mod_pool->head->next = NULL; 
         g_mod_pool->print_num = 0;
@@ -123,7 +140,7 @@ void write_to_log(char *mod_name, char *dep_mod_names, char *str) {
 /* 将内存中的日志信息写入文件 */
 void dump_log(char *filename) {
     log_node_t *pos = NULL, *temp = NULL;
-    char buffer[MAX_BUF_LEN] = {0};
+    char beg_buf[MAX_BUF_LEN], end_buf[MAX_BUF_LEN];
 
     if (g_mod_pool == NULL || g_mod_pool->head == NULL) {
         return;
@@ -133,23 +150,19 @@ void dump_log(char *filename) {
         g_mod_pool->fp = fopen(filename, "a+");
     }
 
+    /* 逐个结点写入文件，模块数多时不会超出固定长度的拼接缓冲区 */
     pthread_mutex_lock(&g_mod_pool->pool_lock);
     pos = g_mod_pool->head->next;
-    while (pos != NULL && pos->next !=NULL) {
-        size_t len_tmp = strlen(buffer);
-        sprintf(buffer+len_tmp,"%-24s%-24s%s\n",ctime(&(pos->beg_time)),ctime(&(pos->beg_time)) ,pos->print_msg);
+    while (pos != NULL) {
+        time_t beg_time = pos->beg_time, end_time = pos->end_time;
+        struct tm tm_beg, tm_end;
+        asctime_r(localtime_r(&beg_time, &tm_beg), beg_buf);
+        asctime_r(localtime_r(&end_time, &tm_end), end_buf);
+        fprintf(g_mod_pool->fp, "%-24s%-24s%s\n", beg_buf, end_buf, pos->print_msg);
         temp = pos;
         pos = pos->next;
         free(temp);
     }
-    /* Write last node in the cache to file */
-    if (pos != NULL) {
-        size_t len_tmp = strlen(buffer);
-        sprintf(buffer+len_tmp,"%-24s%-24s%s\n",ctime(&(pos->beg_time)),ctime(&(pos->beg_time)), pos->print_msg);
-        free(pos);
-    }
- 
-    fwrite(buffer, 1, strlen(buffer), g_mod_pool->fp);
     fflush(g_mod_pool->fp);
  
     g_mod_pool->head->next = NULL;
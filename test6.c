@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
 #include <pthread.h>
 #include <sys/time.h>
 #include <errno.h>
@@ -10,6 +11,13 @@
 #define MAX_MSG_LEN 512                   // 最长记录消息长度
 #define MAX_MODULE_NAME_LEN 32            // 最长模块名长度
 #define DEFAULT_LOG_FILE "/home/boot.log" // 默认日志文件路径
+#define DEFAULT_MAX_MODULE_NUM 64         // 默认最多登记的模块数
+#define MAX_NUM_DEP_MODULES 16            // 最多解析的依赖模块数
+#define MAX_DEP_LIST_LEN 256              // 依赖模块名列表的最大长度
+#define MAX_LOG_SHARDS 64                 // 最多的线程分片数，超出后新线程按分配序号轮流共用已有分片
+#define CACHE_LINE_SIZE 64
+#define DEFAULT_FLUSH_WORKER_NUM 2        // 默认常驻写文件线程数
+#define SOMETIME "-"                      // 耗时列占位
 
 typedef struct _logMsgNode
 {
@@ -22,41 +30,74 @@ typedef struct _logMsgNode
 typedef struct _modulePool
 {
     char moduleName[MAX_MODULE_NAME_LEN];
+    struct timeval firstTv; // 第一条打印时间，写文件时更新
+    struct timeval lastTv;  // 最后一条打印时间，写文件时更新
+    int poolSize;           // 每个分片积压多少条后触发写文件
+    char depModules[MAX_DEP_LIST_LEN]; // 依赖的模块名，逗号分隔，首次带依赖列表打印时记录
+    int depSet;                        // depModules已写入，release发布
+} ModulePool;
+
+// 线程分片：每个线程只追加到自己的分片，分片锁只在写文件摘链时才有竞争
+// 按缓存行对齐，相邻分片不共享缓存行
+typedef struct _logShard
+{
     LogMsgNode *head;      // 链表头指针
     LogMsgNode *tail;      // 链表尾指针
-    int count;             // 当前链表池中的节点数量
-    int poolSize;          // 当前链表池大小
-    pthread_mutex_t mutex; // 互斥锁，防止多线程竞争链表池
-} ModulePool;
+    int count;             // 当前分片中的节点数量
+    int flushPending;      // 是否已在写文件队列中，由threadMutex保护
+    pthread_mutex_t mutex; // 保护分片链表，由所属线程和写文件线程使用
+} __attribute__((aligned(CACHE_LINE_SIZE))) LogShard;
 
 typedef struct _logSystem
 {
     char logFilePath[256];       // 日志文件路径
-    ModulePool *pools;           // 模块链表池数组指针
-    int poolNum;                 // 当前模块链表池数量
-    int maxPoolNum;              // 最大模块链表池数量
-    int maxPoolSize;             // 最大模块链表池大小
-    pthread_mutex_t mutex;       // 整个系统的互斥锁
-    pthread_t *threads;          // 写入日志文件的线程池数组指针
-    int maxThreadNum;            // 最大线程池数量
-    int threadNum;               // 当前线程池内线程数量
-    pthread_mutex_t threadMutex; // 线程池互斥锁
+    ModulePool *pools;           // 模块信息数组指针
+    int poolNum;                 // 当前模块数量，登记时先写模块项再release发布，无锁读取时acquire
+    int maxPoolNum;              // 最大模块数量
+    int maxPoolSize;             // 每个分片积压多少条后触发写文件
+    pthread_mutex_t mutex;       // 整个系统的互斥锁，保护模块登记和分片分配
+    pthread_t *threads;          // 常驻写文件线程数组指针，init时创建
+    int maxThreadNum;            // 写文件线程数量
+    int threadNum;               // 已启动的写文件线程数量
+    pthread_mutex_t threadMutex; // 保护写文件队列
+    LogShard *shards;            // 线程分片数组
+    int shardNum;                // 已分配的分片数量
+    unsigned int shardSeq;       // 已分配过分片的线程数，只增不减，取模得到共用的分片
+    pthread_mutex_t dumpMutex;   // 串行化写文件，保证合并输出不交错
+    pthread_cond_t threadCond;   // 写文件队列非空或退出时唤醒写文件线程
+    int flushQueue[MAX_LOG_SHARDS]; // 积压超过阈值的分片序号，每个分片至多排队一次，队列不会溢出
+    int queueHead;               // 队头下标
+    int queueCount;              // 队列中的分片数
+    int stopping;                // 写文件线程退出标志
 } LogSystem;
 
 // 声明全局变量
-static LogSystem sysLog = {DEFAULT_LOG_FILE, NULL, 0, 0, DEFAULT_POOL_SIZE, PTHREAD_MUTEX_INITIALIZER, NULL, 10, 0, PTHREAD_MUTEX_INITIALIZER};
+static LogSystem sysLog = {
+    .logFilePath = DEFAULT_LOG_FILE,
+    .maxPoolSize = DEFAULT_POOL_SIZE,
+    .mutex = PTHREAD_MUTEX_INITIALIZER,
+    .maxThreadNum = DEFAULT_FLUSH_WORKER_NUM,
+    .threadMutex = PTHREAD_MUTEX_INITIALIZER,
+    .dumpMutex = PTHREAD_MUTEX_INITIALIZER,
+    .threadCond = PTHREAD_COND_INITIALIZER,
+};
+// 当前线程使用的分片
+static __thread LogShard *tlsShard = NULL;
 
 // 辅助函数声明
 static int getModulePoolIndex(char *moduleName);
-static void freeModulePool(ModulePool *pool);
+static int parseDepModuleNameList(char *depModuleNameList, char *depModuleNameArr[]);
+static void freeLogList(LogMsgNode *node);
+static void *flushWorker(void *arg);
+void dumpLog();
 
-// 初始化接口，设置最大模块链表池数量和日志文件路径
+// 初始化接口，设置最大模块数量和日志文件路径
 void init(int maxModulePools, char *logFilePath)
 {
     pthread_mutex_lock(&sysLog.mutex);
-    if (maxModulePools > 0)
+    if (sysLog.pools == NULL)
     {
-        sysLog.maxPoolNum = maxModulePools;
+        sysLog.maxPoolNum = maxModulePools > 0 ? maxModulePools : DEFAULT_MAX_MODULE_NUM;
     }
     if (logFilePath != NULL)
     {
@@ -72,116 +113,263 @@ void init(int maxModulePools, char *logFilePath)
         memset(sysLog.pools, 0, sizeof(ModulePool) * sysLog.maxPoolNum);
         sysLog.poolNum = 0;
     }
+    // 分片被各线程的tlsShard引用，只分配一次，重新初始化时仅清空
+    if (sysLog.shards == NULL)
+    {
+        sysLog.shards = (LogShard *)aligned_alloc(CACHE_LINE_SIZE, sizeof(LogShard) * MAX_LOG_SHARDS);
+        memset(sysLog.shards, 0, sizeof(LogShard) * MAX_LOG_SHARDS);
+        for (int i = 0; i < MAX_LOG_SHARDS; i++)
+        {
+            pthread_mutex_init(&(sysLog.shards[i].mutex), NULL);
+        }
+    }
     int i;
-    for (i = 0; i < sysLog.poolNum; i++)
+    for (i = 0; i < sysLog.shardNum; i++)
     {
-        freeModulePool(&(sysLog.pools[i]));
+        LogShard *shard = &(sysLog.shards[i]);
+        pthread_mutex_lock(&(shard->mutex));
+        freeLogList(shard->head);
+        shard->head = NULL;
+        shard->tail = NULL;
+        shard->count = 0;
+        pthread_mutex_unlock(&(shard->mutex));
     }
-    sysLog.poolNum = 0;
+    __atomic_store_n(&sysLog.poolNum, 0, __ATOMIC_RELEASE);
     pthread_mutex_unlock(&sysLog.mutex);
+
+    // 启动常驻写文件线程，之后打印路径上不再创建线程
+    pthread_mutex_lock(&sysLog.threadMutex);
+    if (sysLog.threads == NULL)
+    {
+        sysLog.threads = (pthread_t *)malloc(sysLog.maxThreadNum * sizeof(pthread_t));
+        sysLog.stopping = 0;
+        for (i = 0; sysLog.threads != NULL && i < sysLog.maxThreadNum; i++)
+        {
+            if (pthread_create(&sysLog.threads[i], NULL, &flushWorker, NULL) != 0)
+            {
+                break;
+            }
+            sysLog.threadNum++;
+        }
+    }
+    pthread_mutex_unlock(&sysLog.threadMutex);
 }
 
-// 记录某个模块打印信息，并自动添加格式前缀，并根据模块名选择对应的链表池进行存储
-void logMessage(char *moduleName, char *depModuleNameList, char *msg)
+// 退出接口，等待写文件线程处理完队列后退出，再把剩余日志写入文件
+void uninit()
 {
-    struct timeval now;
-    gettimeofday(&now, NULL);
-    int module_num = getModulePoolIndex(moduleName);
-    ModulePool *pool = &(sysLog.pools[module_num]);
-    pthread_mutex_lock(&(pool->mutex));
-    if (pool->head == NULL)
+    pthread_mutex_lock(&sysLog.threadMutex);
+    sysLog.stopping = 1;
+    pthread_cond_broadcast(&sysLog.threadCond);
+    pthread_mutex_unlock(&sysLog.threadMutex);
+    for (int i = 0; i < sysLog.threadNum; i++)
     {
-        pool->head = (LogMsgNode *)malloc(sizeof(LogMsgNode));
-        pool->tail = pool->head;
+        pthread_join(sysLog.threads[i], NULL);
     }
-    else
+    free(sysLog.threads);
+    sysLog.threads = NULL;
+    sysLog.threadNum = 0;
+    dumpLog();
+}
+
+// 取得当前线程的分片，首次调用时分配
+static LogShard *getLogShard()
+{
+    if (tlsShard == NULL)
     {
-        pool->tail->next = (LogMsgNode *)malloc(sizeof(LogMsgNode));
-        pool->tail = pool->tail->next;
+        pthread_mutex_lock(&sysLog.mutex);
+        int index = sysLog.shardSeq++ % MAX_LOG_SHARDS;
+        if (sysLog.shardNum < MAX_LOG_SHARDS)
+        {
+            sysLog.shardNum++;
+        }
+        tlsShard = &(sysLog.shards[index]);
+        pthread_mutex_unlock(&sysLog.mutex);
     }
-    pool->tail->next = NULL;
-    strncpy(pool->tail->msg, msg, MAX_MSG_LEN - 1);
-    pool->tail->tv.tv_sec = now.tv_sec;
-    pool->tail->tv.tv_usec = now.tv_usec;
-    pool->count++;
-    if (pool->count > pool->poolSize)
+    return tlsShard;
+}
+
+// 常驻写文件线程，从队列取积压超过阈值的分片并写文件；写文件合并所有分片，多个线程之间由dumpMutex串行
+static void *flushWorker(void *arg)
+{
+    (void)arg;
+    while (1)
     {
-        if (sysLog.threadNum < sysLog.maxThreadNum)
+        pthread_mutex_lock(&sysLog.threadMutex);
+        while (sysLog.queueCount == 0 && !sysLog.stopping)
+        {
+            pthread_cond_wait(&sysLog.threadCond, &sysLog.threadMutex);
+        }
+        if (sysLog.queueCount == 0)
         {
-            pthread_mutex_lock(&sysLog.threadMutex);
-            sysLog.threads = (pthread_t *)realloc(sysLog.threads, (++sysLog.threadNum) * sizeof(pthread_t));
-            pthread_create(&sysLog.threads[sysLog.threadNum - 1], NULL, &dumpLogThread, NULL);
             pthread_mutex_unlock(&sysLog.threadMutex);
+            break;
         }
-        else
+        int index = sysLog.flushQueue[sysLog.queueHead];
+        sysLog.queueHead = (sysLog.queueHead + 1) % MAX_LOG_SHARDS;
+        sysLog.queueCount--;
+        // 先清除排队标志再写文件，写文件期间再次积压的分片可以重新排队
+        sysLog.shards[index].flushPending = 0;
+        pthread_mutex_unlock(&sysLog.threadMutex);
+        dumpLog();
+    }
+    return NULL;
+}
+
+// 将积压超过阈值的分片放入写文件队列，已在队列中的不重复排队
+static void requestFlush(LogShard *shard)
+{
+    pthread_mutex_lock(&sysLog.threadMutex);
+    if (!shard->flushPending)
+    {
+        shard->flushPending = 1;
+        sysLog.flushQueue[(sysLog.queueHead + sysLog.queueCount) % MAX_LOG_SHARDS] = shard - sysLog.shards;
+        sysLog.queueCount++;
+        pthread_cond_signal(&sysLog.threadCond);
+    }
+    pthread_mutex_unlock(&sysLog.threadMutex);
+}
+
+// 内部辅助函数，记录模块依赖的模块名列表，逗号分隔，去掉空项和前导空格，每个模块只记录一次
+static void setModuleDeps(ModulePool *pool, char *depModuleNameList)
+{
+    char buf[MAX_DEP_LIST_LEN];
+    char *depModuleNameArr[MAX_NUM_DEP_MODULES];
+    snprintf(buf, sizeof(buf), "%s", depModuleNameList);
+    int num = parseDepModuleNameList(buf, depModuleNameArr);
+    pthread_mutex_lock(&sysLog.mutex);
+    if (!pool->depSet)
+    {
+        // 各项来自长度相同的buf，拼接结果不会超过depModules
+        int len = 0;
+        for (int i = 0; i < num; i++)
         {
-            dumpLog();
+            len += snprintf(pool->depModules + len, sizeof(pool->depModules) - len, "%s%s", i > 0 ? "," : "", depModuleNameArr[i]);
         }
+        __atomic_store_n(&pool->depSet, 1, __ATOMIC_RELEASE);
     }
-    pthread_mutex_unlock(&(pool->mutex));
+    pthread_mutex_unlock(&sysLog.mutex);
 }
 
-// 获取某个模块当前的链表池数量索引，并增加新的链表池记录
-int getModulePoolIndex(char *moduleName)
+// 内部辅助函数，取模块依赖的模块名列表，未记录时为空串
+static const char *getModuleDeps(ModulePool *pool)
 {
-    int i;
-    ModulePool *pool;
-    for (i = 0; i < sysLog.poolNum; i++)
+    return __atomic_load_n(&pool->depSet, __ATOMIC_ACQUIRE) ? pool->depModules : "";
+}
+
+// 记录某个模块打印信息，追加到当前线程的分片，同一模块的多个线程互不竞争
+void logMessage(char *moduleName, char *depModuleNameList, char *msg)
+{
+    int module_num = getModulePoolIndex(moduleName);
+    if (module_num < 0)
+    {
+        return;
+    }
+    if (depModuleNameList != NULL && depModuleNameList[0] != '\0' &&
+        !__atomic_load_n(&sysLog.pools[module_num].depSet, __ATOMIC_ACQUIRE))
+    {
+        setModuleDeps(&sysLog.pools[module_num], depModuleNameList);
+    }
+    LogMsgNode *node = (LogMsgNode *)malloc(sizeof(LogMsgNode));
+    if (node == NULL)
+    {
+        return;
+    }
+    strncpy(node->msg, msg, MAX_MSG_LEN - 1);
+    node->msg[MAX_MSG_LEN - 1] = '\0';
+    node->module_num = module_num;
+    node->next = NULL;
+
+    LogShard *shard = getLogShard();
+    pthread_mutex_lock(&(shard->mutex));
+    // 在分片锁内取时间，共用分片时链表仍按时间有序
+    gettimeofday(&(node->tv), NULL);
+    if (shard->head == NULL)
+    {
+        shard->head = node;
+    }
+    else
+    {
+        shard->tail->next = node;
+    }
+    shard->tail = node;
+    int overflow = ++shard->count > sysLog.pools[module_num].poolSize;
+    pthread_mutex_unlock(&(shard->mutex));
+
+    // 只通知写文件线程，生产者不创建线程也不做文件I/O
+    if (overflow)
+    {
+        requestFlush(shard);
+    }
+}
+
+// 无锁查找已登记的模块，只看已发布的模块项
+static int findModulePoolIndex(char *moduleName)
+{
+    int i, poolNum = __atomic_load_n(&sysLog.poolNum, __ATOMIC_ACQUIRE);
+    for (i = 0; i < poolNum; i++)
     {
-        pool = &(sysLog.pools[i]);
-        if (!strcmp(pool->moduleName, moduleName))
+        if (!strcmp(sysLog.pools[i].moduleName, moduleName))
         {
             return i;
         }
     }
-    if (sysLog.poolNum >= sysLog.maxPoolNum)
+    return -1;
+}
+
+// 获取某个模块的索引，不存在时登记新模块
+int getModulePoolIndex(char *moduleName)
+{
+    int i = findModulePoolIndex(moduleName);
+    if (i >= 0)
+    {
+        return i;
+    }
+    pthread_mutex_lock(&sysLog.mutex);
+    i = findModulePoolIndex(moduleName);
+    if (i < 0 && sysLog.poolNum < sysLog.maxPoolNum)
     {
-        return -1;
+        ModulePool *pool = &(sysLog.pools[sysLog.poolNum]);
+        memset(pool, 0, sizeof(ModulePool));
+        snprintf(pool->moduleName, MAX_MODULE_NAME_LEN - 1, "%s", moduleName);
+        pool->poolSize = sysLog.maxPoolSize;
+        i = sysLog.poolNum;
+        __atomic_store_n(&sysLog.poolNum, i + 1, __ATOMIC_RELEASE);
     }
-    memset(&(sysLog.pools[sysLog.poolNum]), 0, sizeof(ModulePool));
-    pool = &(sysLog.pools[sysLog.poolNum]);
-    snprintf(pool->moduleName, MAX_MODULE_NAME_LEN - 1, "%s", moduleName);
-    pthread_mutex_init(&(pool->mutex), NULL);
-    pool->poolSize = sysLog.maxPoolSize;
-    sysLog.poolNum++;
-    return sysLog.poolNum - 1;
+    pthread_mutex_unlock(&sysLog.mutex);
+    return i;
 }
 
 // 输出所有模块的第一条打印时间和最后一条打印时间的时间差，以及模块依赖的其它模块名字符串
+// 首末时间在写文件时更新，只统计已写入文件的日志
 char *calcModuleTimeCost()
 {
     static char result[1024 * 1024] = {0}; // 存放结果字符串，静态内存分配
-    struct timeval startTime, endTime;
     char timeDiffStr[32] = {0};
     int maxDepModListLen = 1024;
     char *depModList = (char *)malloc(maxDepModListLen); // 动态内存分配
     memset(result, 0, sizeof(result));                   // 清空结果字符串
-    int i, j;
-    for (i = 0; i < sysLog.poolNum; i++)
+    int i, j, poolNum = __atomic_load_n(&sysLog.poolNum, __ATOMIC_ACQUIRE);
+    for (i = 0; i < poolNum; i++)
     {
-        if (sysLog.pools[i].head == NULL)
+        ModulePool *pool = &(sysLog.pools[i]);
+        if (pool->firstTv.tv_sec == 0)
             continue;
-        gettimeofday(&startTime, NULL); // 开始计算耗时
-        LogMsgNode *node = sysLog.pools[i].head;
-        while (node != NULL)
-        {
-            node = node->next;
-        }
-        gettimeofday(&endTime, NULL); // 计算完毕
-        int hour = (int)((endTime.tv_sec - startTime.tv_sec) / 3600);
-        int min = (int)(((endTime.tv_sec - startTime.tv_sec) % 3600) / 60);
-        int sec = (int)((endTime.tv_sec - startTime.tv_sec) % 60);
+        long cost = pool->lastTv.tv_sec - pool->firstTv.tv_sec;
+        int hour = (int)(cost / 3600);
+        int min = (int)((cost % 3600) / 60);
+        int sec = (int)(cost % 60);
         snprintf(timeDiffStr, sizeof(timeDiffStr) - 1, "[%02d:%02d:%02d]", hour, min, sec);
-        snprintf(depModList, maxDepModListLen - 1, "Dependence:%s", sysLog.pools[i].moduleName);
+        snprintf(depModList, maxDepModListLen - 1, "Dependence:%s", getModuleDeps(pool));
         for (j = 0; j < strlen(depModList); j++)
         {
             depModList[j] = toupper(depModList[j]); // 转换为大写字母
         }
         snprintf(result + strlen(result), sizeof(result) - strlen(result) - 1, "%s %ld.%06ld|%s|%-12s|%s\n",
                  timeDiffStr,
-                 sysLog.pools[i].head->tv.tv_sec,
-                 sysLog.pools[i].head->tv.tv_usec,
-                 sysLog.pools[i].moduleName,
+                 pool->firstTv.tv_sec,
+                 pool->firstTv.tv_usec,
+                 pool->moduleName,
                  SOMETIME,
                  depModList);
     }
@@ -189,125 +377,178 @@ char *calcModuleTimeCost()
     return result;
 }
 
-// 内部辅助函数，将一个模块的链表池全部写入文件
-static void dumpModuleLog(ModulePool *pool, FILE *file)
+// 按时间戳比较两个节点，相同时按分片序号，保证输出稳定
+static int logNodeBefore(LogMsgNode *a, int ia, LogMsgNode *b, int ib)
 {
-    struct timeval startTime, endTime;
-    gettimeofday(&startTime, NULL);
-    LogMsgNode *node = pool->head;
-    char timeDiffStr[32] = {0};
-    char depModuleNameList[1024] = {0};
-    int isFirstNode = 1;
-    while (node != NULL)
+    if (a->tv.tv_sec != b->tv.tv_sec)
     {
-        if (isFirstNode)
+        return a->tv.tv_sec < b->tv.tv_sec;
+    }
+    if (a->tv.tv_usec != b->tv.tv_usec)
+    {
+        return a->tv.tv_usec < b->tv.tv_usec;
+    }
+    return ia < ib;
+}
+
+// 内部辅助函数，k路归并各分片的有序链表，按时间顺序逐个交给visit处理，返回处理的节点数
+// lists作为各分片的游标会被修改；visit返回前节点已从游标上取下，可在visit中释放
+static int mergeLogLists(LogMsgNode *lists[], int k, void (*visit)(LogMsgNode *node, void *arg), void *arg)
+{
+    int heap[MAX_LOG_SHARDS]; // 以各分片当前节点为键的小顶堆，存分片序号
+    int n = 0, count = 0;
+    int i;
+    for (i = 0; i < k; i++)
+    {
+        if (lists[i] == NULL)
+            continue;
+        int c = n++;
+        while (c > 0 && logNodeBefore(lists[i], i, lists[heap[(c - 1) / 2]], heap[(c - 1) / 2]))
         {
-            isFirstNode = 0;
+            heap[c] = heap[(c - 1) / 2];
+            c = (c - 1) / 2;
         }
-        else
+        heap[c] = i;
+    }
+    while (n > 0)
+    {
+        int top = heap[0];
+        LogMsgNode *node = lists[top];
+        lists[top] = node->next;
+        if (lists[top] == NULL)
         {
-            fprintf(file, "\n"); // 打印两个消息之间的换行符
+            top = heap[--n];
         }
-        // 将消息写入文件
-        int hour = (int)(node->tv.tv_sec / 3600);
-        int min = (int)((node->tv.tv_sec % 3600) / 60);
-        int sec = (int)(node->tv.tv_sec % 60);
-        snprintf(timeDiffStr, sizeof(timeDiffStr) - 1, "[%02d:%02d:%02d.%06ld]", hour, min, sec, node->tv.tv_usec);
-        // 将依赖模块列表转换成大写
-        if (depModuleNameList[0] != '\0')
+        // 下沉堆顶
+        int c = 0;
+        while (2 * c + 1 < n)
         {
-            for (int j = 0; j < strlen(depModuleNameList); j++)
+            int child = 2 * c + 1;
+            if (child + 1 < n && logNodeBefore(lists[heap[child + 1]], heap[child + 1], lists[heap[child]], heap[child]))
             {
-                depModuleNameList[j] = toupper(depModuleNameList[j]);
+                child++;
             }
+            if (!logNodeBefore(lists[heap[child]], heap[child], lists[top], top))
+            {
+                break;
+            }
+            heap[c] = heap[child];
+            c = child;
+        }
+        if (n > 0)
+        {
+            heap[c] = top;
         }
-        fprintf(file, "%s |%-12s|%-15s|%s", timeDiffStr, pool->moduleName, SOMETIME, depModuleNameList);
-        fflush(file);
-        fwrite(node->msg, strlen(node->msg), 1, file);
-        fflush(file);
-        node = node->next;
+        visit(node, arg);
+        count++;
     }
-    gettimeofday(&endTime, NULL);
-    fprintf(stdout, "[%s]: dump log of %s to file success, cost %d usec.\n", __func__, pool->moduleName, (int)((endTime.tv_sec - startTime.tv_sec) * 1000000 + (endTime.tv_usec - startTime.tv_usec)));
+    return count;
+}
+
+// 内部辅助函数，将一条日志写入文件，并更新所属模块的首末打印时间
+static void dumpLogNode(LogMsgNode *node, void *arg)
+{
+    FILE *file = (FILE *)arg;
+    ModulePool *pool = &(sysLog.pools[node->module_num]);
+    char timeDiffStr[32] = {0};
+    const char *deps = getModuleDeps(pool);
+    int hour = (int)(node->tv.tv_sec / 3600);
+    int min = (int)((node->tv.tv_sec % 3600) / 60);
+    int sec = (int)(node->tv.tv_sec % 60);
+    snprintf(timeDiffStr, sizeof(timeDiffStr) - 1, "[%02d:%02d:%02d.%06ld]", hour, min, sec, node->tv.tv_usec);
+    fprintf(file, "%s |%-12s|%-15s|%s%s%s\n", timeDiffStr, pool->moduleName, SOMETIME, deps, deps[0] != '\0' ? "|" : "",
+            node->msg);
+    if (pool->firstTv.tv_sec == 0)
+    {
+        pool->firstTv = node->tv;
+    }
+    pool->lastTv = node->tv;
+    free(node);
 }
 
-// 将当前所有模块的链表池内的消息全部写入文件并清空链表池
+// 将所有分片内的消息按时间顺序合并写入文件并清空分片
 void dumpLog()
 {
+    LogMsgNode *lists[MAX_LOG_SHARDS];
+    int i, shardNum, writeCount = 0;
+    struct timeval startTime, endTime;
+
+    pthread_mutex_lock(&sysLog.dumpMutex);
+    gettimeofday(&startTime, NULL);
+    // 先锁住所有分片再一起摘链：时间在分片锁内获取，摘下的节点都早于之后追加的节点，
+    // 各次写文件之间仍按时间有序；写文件期间生产者继续追加
+    pthread_mutex_lock(&sysLog.mutex);
+    shardNum = sysLog.shardNum;
+    pthread_mutex_unlock(&sysLog.mutex);
+    for (i = 0; i < shardNum; i++)
+    {
+        pthread_mutex_lock(&(sysLog.shards[i].mutex));
+    }
+    for (i = 0; i < shardNum; i++)
+    {
+        LogShard *shard = &(sysLog.shards[i]);
+        lists[i] = shard->head;
+        shard->head = NULL;
+        shard->tail = NULL;
+        shard->count = 0;
+    }
+    for (i = shardNum - 1; i >= 0; i--)
+    {
+        pthread_mutex_unlock(&(sysLog.shards[i].mutex));
+    }
+
     FILE *fout = fopen(sysLog.logFilePath, "a+");
     if (fout == NULL)
     {
         fprintf(stderr, "[%s]: cannot open file %s, %s.\n", __func__, sysLog.logFilePath, strerror(errno));
+        for (i = 0; i < shardNum; i++)
+        {
+            freeLogList(lists[i]);
+        }
+        pthread_mutex_unlock(&sysLog.dumpMutex);
         return;
     }
-    int i, writeCount = 0;
-    struct timeval startTime, endTime;
-    gettimeofday(&startTime, NULL);
-    for (i = 0; i < sysLog.poolNum; i++)
-    {
-        if (sysLog.pools[i].count <= 0)
-            continue;
-        pthread_mutex_lock(&(sysLog.pools[i].mutex));
-        dumpModuleLog(&(sysLog.pools[i]), fout);
-        freeModulePool(&(sysLog.pools[i]));
-        pthread_mutex_unlock(&(sysLog.pools[i].mutex));
-        writeCount += sysLog.pools[i].count;
-    }
+    writeCount = mergeLogLists(lists, shardNum, dumpLogNode, fout);
     fflush(fout);
     fclose(fout);
     gettimeofday(&endTime, NULL);
+    pthread_mutex_unlock(&sysLog.dumpMutex);
     fprintf(stdout, "[%s]: dump %d logs to file success, cost %d usec.\n", __func__, writeCount, (int)((endTime.tv_sec - startTime.tv_sec) * 1000000 + (endTime.tv_usec - startTime.tv_usec)));
 }
 
-// 内部辅助函数，释放一个模块的链表池内存
-static void freeModulePool(ModulePool *pool)
+// 内部辅助函数，释放一条日志链表
+static void freeLogList(LogMsgNode *node)
 {
-    if (pool->head == NULL)
-    {
-        return;
-    }
-    LogMsgNode *freeNode = pool->head;
-    while (freeNode != NULL)
+    while (node != NULL)
     {
-        LogMsgNode *nextFreeNode = freeNode->next;
-        free(freeNode);
-        freeNode = nextFreeNode;
+        LogMsgNode *nextFreeNode = node->next;
+        free(node);
+        node = nextFreeNode;
     }
-    pool->head = NULL;
-    pool->tail = NULL;
-    pool->count = 0;
 }
 
 // 内部辅助函数，从指定字符串中解析出逗号分隔的模块名列表，并返回模块数量
+// 会修改传入的字符串，多个线程可同时调用
 static int parseDepModuleNameList(char *depModuleNameList, char *depModuleNameArr[])
 {
     int count = 0;
-    char *tok = strtok(depModuleNameList, ",");
+    char *save = NULL;
+    char *tok = strtok_r(depModuleNameList, ",", &save);
     while (tok != NULL && count < MAX_NUM_DEP_MODULES)
     {
-        depModuleNameArr[count++] = tok;
-        tok = strtok(NULL, ",");
+        while (isspace((unsigned char)*tok))
+        {
+            tok++;
+        }
+        if (*tok != '\0')
+        {
+            depModuleNameArr[count++] = tok;
+        }
+        tok = strtok_r(NULL, ",", &save);
     }
     return count;
 }
 
-// 内部辅助函数，从当前时间减去起始时间，并返回结果字符串
-static char *getTimeCostStr(struct timeval startTime)
-{
-    static char result[32] = {0};
-    struct timeval now;
-    gettimeofday(&now, NULL);
-    int usec_diff = now.tv_usec - startTime.tv_usec;
-    int sec_diff = now.tv_sec - startTime.tv_sec;
-    if (usec_diff < 0)
-    {
-        usec_diff += 1000000;
-        sec_diff--;
-    }
-    snprintf(result, sizeof(result) - 1, "%d.%06d", sec_diff, usec_diff);
-    return result;
-}
-
 // 将每个模块的首次打印时间、最新打印时间、以及二者时间差，追加到指定文件中
 // void createModuleCostFile(char* filePath){
 //    if(filePath == NULL) return;
@@ -315,27 +556,148 @@ static char *getTimeCostStr(struct timeval startTime)
 //   if(fout == NULL){
 //   fprintf(stderr, "[%s]: cannot open file %s, %s.\n", __func__, filePath,
 
-// 输出该模块的所有打印到文件
+typedef struct _moduleLogFile
+{
+    FILE *fp;
+    int module_num;
+} ModuleLogFile;
+
+static void writeModuleLogNode(LogMsgNode *node, void *arg)
+{
+    ModuleLogFile *out = (ModuleLogFile *)arg;
+    if (node->module_num == out->module_num)
+    {
+        fprintf(out->fp, "%ld.%06ld %s\n", node->tv.tv_sec, node->tv.tv_usec, node->msg);
+    }
+}
+
+// 输出该模块尚未写入日志文件的所有打印到文件，按时间顺序
 void createModuleLogFile(char *moduleName)
 {
-    int module_num = getModulePoolIndex(moduleName);
-    ModulePool *pool = &(sysLog.pools[module_num]);
-    pthread_mutex_lock(&(pool->mutex));
+    int module_num = findModulePoolIndex(moduleName);
+    if (module_num < 0)
+    {
+        return;
+    }
     char costFilePath[256];
     snprintf(costFilePath, sizeof(costFilePath), "%s.%s", sysLog.logFilePath, moduleName);
     FILE *fp = fopen(costFilePath, "w");
     if (fp == NULL)
     {
         fprintf(stderr, "Failed to open module cost file %s: %s\n", costFilePath, strerror(errno));
-        pthread_mutex_unlock(&(pool->mutex));
         return;
     }
-    LogMsgNode *node = pool->head;
-    while (node != NULL)
+    LogMsgNode *lists[MAX_LOG_SHARDS];
+    ModuleLogFile out = {fp, module_num};
+    int i, shardNum;
+    pthread_mutex_lock(&sysLog.mutex);
+    shardNum = sysLog.shardNum;
+    pthread_mutex_unlock(&sysLog.mutex);
+    // 不摘链，遍历期间锁住所有分片
+    for (i = 0; i < shardNum; i++)
     {
-        fprintf(fp, "%ld.%06ld %s\n", node->tv.tv_sec, node->tv.tv_usec, node->msg);
-        node = node->next;
+        pthread_mutex_lock(&(sysLog.shards[i].mutex));
+        lists[i] = sysLog.shards[i].head;
+    }
+    mergeLogLists(lists, shardNum, writeModuleLogNode, &out);
+    for (i = shardNum - 1; i >= 0; i--)
+    {
+        pthread_mutex_unlock(&(sysLog.shards[i].mutex));
     }
     fclose(fp);
-    pthread_mutex_unlock(&(pool->mutex));
-}
\ No newline at end of file
+}
+
+#ifdef LOG_CONTENTION_BENCH
+#define BENCH_THREADS 16
+#define BENCH_PER_THREAD 20000
+
+// 原先按模块分池、同模块所有线程共用一把锁和一条链表的写法，作为对照
+static struct
+{
+    LogMsgNode *head;
+    LogMsgNode *tail;
+    int count;
+    pthread_mutex_t mutex;
+} benchModulePool = {NULL, NULL, 0, PTHREAD_MUTEX_INITIALIZER};
+
+static void *benchModulePoolProducer(void *arg)
+{
+    for (int i = 0; i < BENCH_PER_THREAD; i++)
+    {
+        struct timeval now;
+        gettimeofday(&now, NULL);
+        pthread_mutex_lock(&benchModulePool.mutex);
+        LogMsgNode *node = (LogMsgNode *)malloc(sizeof(LogMsgNode));
+        if (benchModulePool.head == NULL)
+        {
+            benchModulePool.head = node;
+        }
+        else
+        {
+            benchModulePool.tail->next = node;
+        }
+        benchModulePool.tail = node;
+        node->next = NULL;
+        strncpy(node->msg, "contention benchmark entry", MAX_MSG_LEN - 1);
+        node->tv = now;
+        benchModulePool.count++;
+        pthread_mutex_unlock(&benchModulePool.mutex);
+    }
+    return NULL;
+}
+
+static void *benchShardProducer(void *arg)
+{
+    for (int i = 0; i < BENCH_PER_THREAD; i++)
+    {
+        logMessage("bench", NULL, "contention benchmark entry");
+    }
+    return NULL;
+}
+
+static double benchRun(void *(*producer)(void *))
+{
+    pthread_t tids[BENCH_THREADS];
+    struct timeval beg, end;
+    gettimeofday(&beg, NULL);
+    for (int i = 0; i < BENCH_THREADS; i++)
+    {
+        pthread_create(&tids[i], NULL, producer, NULL);
+    }
+    for (int i = 0; i < BENCH_THREADS; i++)
+    {
+        pthread_join(tids[i], NULL);
+    }
+    gettimeofday(&end, NULL);
+    return ((end.tv_sec - beg.tv_sec) * 1e6 + (end.tv_usec - beg.tv_usec)) * 1e3 / (BENCH_THREADS * BENCH_PER_THREAD);
+}
+
+// 16个线程向同一模块打印，对比同模块共用一把锁与按线程分片的单条耗时
+static void runContentionBench()
+{
+    init(0, "/dev/null");
+    sysLog.maxPoolSize = BENCH_THREADS * BENCH_PER_THREAD + 1; // 计时期间不触发写文件
+    printf("%-14s%-14s\n", "path", "ns/entry");
+    printf("%-14s%-14.1f\n", "module pool", benchRun(benchModulePoolProducer));
+    freeLogList(benchModulePool.head);
+    printf("%-14s%-14.1f\n", "shards", benchRun(benchShardProducer));
+    // 合并写文件的耗时由dumpLog自行输出
+    uninit();
+}
+#endif
+
+int main()
+{
+#ifdef LOG_CONTENTION_BENCH
+    runContentionBench();
+    return 0;
+#endif
+
+    init(0, "./boot.log");
+    logMessage("Module A", NULL, "This is a log entry of Module A.");
+    logMessage("Module B", "Module A", "This is a log entry of Module B.");
+    logMessage("Module A", NULL, "The last log entry of Module A.");
+    uninit();
+    printf("%s", calcModuleTimeCost());
+    return 0;
+}
@@ -3,6 +3,7 @@
 #include <string.h>
 #include <time.h>
 #include <stdarg.h>
+#include "bootlog-format.h"
 
 #define MAX_MODULE_LEN 32
 #define MAX_DEPENDENCE_LEN 64
@@ -10,21 +11,48 @@
 #define DEFAULT_POOL_SIZE 300
 #define DEFAULT_LOG_PATH "./boot.log"
 #define DEFAULT_THRESHOLD 200
+#define MAX_MODULE_NUM 64 // 每块模块结点数，init时分配一块，模块数超出时再按块扩展
+#define LOG_FILE_BUF_SIZE 4096
+
+// 距该模块第一句打印的时间的输出精度，取值为小数位数
+#define LOG_TIME_PRECISION_S 0
+#define LOG_TIME_PRECISION_MS 3
+#define LOG_TIME_PRECISION_US 6
+
+// 打印级别，记录在调用点描述符中
+#define BOOTLOG_LEVEL_ERROR 0
+#define BOOTLOG_LEVEL_WARN 1
+#define BOOTLOG_LEVEL_INFO 2
+#define BOOTLOG_LEVEL_DEBUG 3
+
+// BOOTLOG调用点的参数捕获方式
+#define BOOTLOG_CAPTURE_EAGER 0 // 调用方立即格式化
+#define BOOTLOG_CAPTURE_LAZY 1  // 调用方只拷贝原始参数，写文件时再格式化
 
 typedef struct LogNode
 {
     char module[MAX_MODULE_LEN];
     time_t first;
     time_t last;
+    long long first_ns; // 单调时钟纳秒，计算耗时不受墙上时间调整的影响
+    long long last_ns;
     char dependence[MAX_DEPENDENCE_LEN];
     struct LogNode *next;
 } LogNode;
 
+// 模块结点按块分配，块之间串成链表，cleanup时一起释放
+typedef struct LogModuleSlab
+{
+    struct LogModuleSlab *next;
+    LogNode nodes[MAX_MODULE_NUM];
+} LogModuleSlab;
+
 typedef struct LogMessage
 {
     time_t timestamp;
     char module[MAX_MODULE_LEN];
-    int seconds_from_first;
+    long long ns_from_first;
+    struct BootlogSite *site; // 非NULL时log中是该调用点的原始参数，写文件时再格式化
     char log[MAX_LOG_LEN];
 } LogMessage;
 
@@ -34,179 +62,460 @@ typedef struct LogPoolNode
     struct LogPoolNode *next;
 } LogPoolNode;
 
+// BOOTLOG调用点描述符，bootlog_sites段的组织方式同test8.c
+typedef struct BootlogSite
+{
+    const char *module;
+    const char *format;
+    const char *file;
+    int line;
+    int level;
+    unsigned long count; // 该调用点的打印次数
+    LogNode *module_node; // 首次打印后缓存的模块结点，之后不再按模块名查找
+    bootlog_fmt_t fmt; // 首次打印时解析一次格式串，延迟格式化按此取参数和分段格式化
+} BootlogSite;
+
+// 链接器为bootlog_sites段生成的起止地址，程序中没有调用点时为空
+extern BootlogSite *const __start_bootlog_sites[] __attribute__((weak));
+extern BootlogSite *const __stop_bootlog_sites[] __attribute__((weak));
+
+void bootlog_site_log(unsigned int site_id, ...);
+
+// 按调用点打印，同test8.c的BOOTLOG_AT
+#define BOOTLOG_AT(lvl, mod, fmt, ...)                                                          \
+    do                                                                                          \
+    {                                                                                           \
+        static BootlogSite bootlog_site_ = {mod, fmt, __FILE__, __LINE__, lvl, 0, NULL, {0}};  \
+        static BootlogSite *const bootlog_site_ptr_                                             \
+            __attribute__((section("bootlog_sites"), used, aligned(sizeof(void *)))) = &bootlog_site_; \
+        if (0)                                                                                  \
+        {                                                                                       \
+            printf(fmt, ##__VA_ARGS__);                                                         \
+        }                                                                                       \
+        bootlog_site_log(&bootlog_site_ptr_ - __start_bootlog_sites, ##__VA_ARGS__);            \
+    } while (0)
+#define BOOTLOG(mod, fmt, ...) BOOTLOG_AT(BOOTLOG_LEVEL_INFO, mod, fmt, ##__VA_ARGS__)
+
 static LogPoolNode *g_pool_head = NULL;
+static LogPoolNode *g_pool_tail = NULL;
 static LogNode *g_log_list_head = NULL;
-static size_t g_log_pool_size = 0;
+static size_t g_log_pool_size = 0;  // 链表池容量
+static size_t g_log_pool_count = 0; // 链表池中待写的打印数量
 static char *g_log_path = NULL;
 static size_t g_threshold = 0;
+static FILE *g_log_fp = NULL;
+static int g_log_time_precision = LOG_TIME_PRECISION_S;
+static int g_boot_log_capture_mode = BOOTLOG_CAPTURE_LAZY;
+
+// 链表池结点和第一块模块结点在init时分配，打印时只从空闲链表中取；
+// 只有出现新模块且空闲模块结点用完时才再分配一块
+static LogPoolNode *g_pool_slab = NULL;
+static LogPoolNode *g_pool_free = NULL;
+static LogModuleSlab *g_module_slab = NULL;
+static LogNode *g_module_free = NULL;
+static unsigned long g_module_dropped = 0; // 扩展模块结点失败而丢弃的打印数
+
+void cleanup_logger();
+
+// 分配一块模块结点并挂到空闲链表，失败时返回-1
+static int grow_module_slab()
+{
+    LogModuleSlab *slab = (LogModuleSlab *)calloc(1, sizeof(LogModuleSlab));
+    if (slab == NULL)
+    {
+        return -1;
+    }
+    for (size_t i = 0; i < MAX_MODULE_NUM; i++)
+    {
+        slab->nodes[i].next = (i + 1 < MAX_MODULE_NUM) ? &slab->nodes[i + 1] : g_module_free;
+    }
+    g_module_free = slab->nodes;
+    slab->next = g_module_slab;
+    g_module_slab = slab;
+    return 0;
+}
 
 // 初始化接口
 void init_logger(size_t max_log_pool_size, const char *log_path, size_t threshold)
 {
+    cleanup_logger();
+
     g_log_pool_size = (max_log_pool_size == 0) ? DEFAULT_POOL_SIZE : max_log_pool_size;
     g_log_path = (log_path == NULL) ? strdup(DEFAULT_LOG_PATH) : strdup(log_path);
     g_threshold = (threshold == 0) ? DEFAULT_THRESHOLD : threshold;
 
-    if (g_log_list_head != NULL)
+    g_pool_slab = (LogPoolNode *)calloc(g_log_pool_size, sizeof(LogPoolNode));
+    if (g_pool_slab == NULL || grow_module_slab() != 0)
+    {
+        printf("memory allocation error\n");
+        return;
+    }
+    for (size_t i = 0; i < g_log_pool_size; i++)
+    {
+        g_pool_slab[i].next = (i + 1 < g_log_pool_size) ? &g_pool_slab[i + 1] : NULL;
+    }
+    g_pool_free = g_pool_slab;
+
+    // 日志文件在init时打开并使用静态缓冲区，提前加载时区，写文件时不再分配内存
+    static char log_file_buf[LOG_FILE_BUF_SIZE];
+    g_log_fp = fopen(g_log_path, "a+");
+    if (g_log_fp == NULL)
     {
-        free(g_log_list_head);
-        g_log_list_head = NULL;
+        printf("open file failed.\n");
+        return;
     }
+    setvbuf(g_log_fp, log_file_buf, _IOFBF, LOG_FILE_BUF_SIZE);
+    tzset();
 }
 
-// 打印日志
-void log_message(const char *module, const char *dependence, const char *format, ...)
+// 设置耗时的输出精度(LOG_TIME_PRECISION_S/MS/US)
+int set_log_time_precision(int precision)
 {
+    if (precision != LOG_TIME_PRECISION_S && precision != LOG_TIME_PRECISION_MS && precision != LOG_TIME_PRECISION_US)
+    {
+        return -1;
+    }
+    g_log_time_precision = precision;
+    return 0;
+}
 
-    // 获取当前时间戳
-    const time_t timestamp = time(NULL);
+// 读取单调时钟纳秒
+static long long log_mono_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
 
-    // 拼接打印字符串
-    char log[MAX_LOG_LEN] = {0};
-    va_list args;
-    va_start(args, format);
-    vsnprintf(log, MAX_LOG_LEN - 1, format, args);
-    va_end(args);
+// 按输出精度把纳秒时长格式化为秒数，精度以下的部分截断
+static void format_log_elapsed(char *dst, size_t len, long long ns)
+{
+    long long unit = 1;
+    for (int i = g_log_time_precision; i < 9; i++)
+    {
+        unit *= 10;
+    }
+    if (g_log_time_precision == LOG_TIME_PRECISION_S)
+    {
+        snprintf(dst, len, "%lld", ns / unit);
+        return;
+    }
+    snprintf(dst, len, "%lld.%0*lld", ns / 1000000000, g_log_time_precision, ns % 1000000000 / unit);
+}
 
-    // 判断模块是否已经存在，若不存在则添加到模块列表中
+// 将链表池中的打印全部写入文件，结点归还空闲链表
+static void flush_log_pool()
+{
+    while (g_pool_head != NULL)
+    {
+        if (g_log_fp != NULL)
+        {
+            char elapsed[32];
+            char text[MAX_LOG_LEN];
+            const char *log = g_pool_head->data.log;
+            format_log_elapsed(elapsed, sizeof(elapsed), g_pool_head->data.ns_from_first);
+            // 延迟格式化的打印在此格式化，截断长度与立即格式化相同
+            if (g_pool_head->data.site != NULL)
+            {
+                render_bootlog_args(g_pool_head->data.site->format, &g_pool_head->data.site->fmt, log, text, MAX_LOG_LEN - 1);
+                log = text;
+            }
+            fprintf(g_log_fp, "[%ld][%s][%s] %s\n",
+                    g_pool_head->data.timestamp, g_pool_head->data.module,
+                    elapsed, log);
+        }
+        LogPoolNode *current_node = g_pool_head;
+        g_pool_head = g_pool_head->next;
+        current_node->next = g_pool_free;
+        g_pool_free = current_node;
+    }
+    g_pool_tail = NULL;
+    g_log_pool_count = 0;
+    if (g_log_fp != NULL)
+    {
+        fflush(g_log_fp);
+    }
+}
+
+// 查找模块结点，不存在时新建(dependence为NULL时依赖信息为空)；扩展模块结点失败时计数并返回NULL
+static LogNode *get_module_node(const char *module, const char *dependence, time_t timestamp, long long now_ns)
+{
     LogNode *current_node = g_log_list_head;
     while (current_node != NULL)
     {
         if (strncmp(current_node->module, module, MAX_MODULE_LEN) == 0)
         {
-            break;
+            return current_node;
         }
         current_node = current_node->next;
     }
-    if (current_node == NULL)
+
+    if (g_module_free == NULL && grow_module_slab() != 0)
     {
-        current_node = (LogNode *)calloc(1, sizeof(LogNode));
-        if (current_node == NULL)
-        {
-            printf("memory allocation error\n");
-            return;
-        }
-        strncpy(current_node->module, module, MAX_MODULE_LEN);
-        current_node->first = timestamp;
-        current_node->last = timestamp;
-        strncpy(current_node->dependence, dependence, MAX_DEPENDENCE_LEN);
-        current_node->next = g_log_list_head;
-        g_log_list_head = current_node;
+        g_module_dropped++;
+        return NULL;
     }
-    else
+    current_node = g_module_free;
+    g_module_free = current_node->next;
+    memset(current_node, 0, sizeof(LogNode));
+    strncpy(current_node->module, module, MAX_MODULE_LEN);
+    current_node->first = timestamp;
+    current_node->first_ns = now_ns;
+    strncpy(current_node->dependence, dependence != NULL ? dependence : "", MAX_DEPENDENCE_LEN);
+    current_node->next = g_log_list_head;
+    g_log_list_head = current_node;
+    return current_node;
+}
+
+// 从空闲链表取一个结点并填好模块名和时间，链表池已满时先写入文件腾出结点
+static LogPoolNode *take_log_pool_node(LogNode *module_node, time_t timestamp, long long now_ns)
+{
+    if (g_pool_free == NULL)
     {
-        current_node->last = timestamp;
+        flush_log_pool();
     }
-
-    // 计算本次打印距离该模块第一句打印的秒数
-    int seconds_from_first = difftime(timestamp, current_node->first);
-
-    // 将消息加入链表池
-    LogPoolNode *new_node = (LogPoolNode *)calloc(1, sizeof(LogPoolNode));
+    LogPoolNode *new_node = g_pool_free;
     if (new_node == NULL)
     {
         printf("failed to allocate memory!\n");
-        return;
+        return NULL;
     }
+    g_pool_free = new_node->next;
     new_node->next = NULL;
-    snprintf(new_node->data.module, MAX_MODULE_LEN - 1, "%s", module);
+    memcpy(new_node->data.module, module_node->module, MAX_MODULE_LEN);
+    new_node->data.module[MAX_MODULE_LEN - 1] = '\0';
     new_node->data.timestamp = timestamp;
-    new_node->data.seconds_from_first = seconds_from_first;
-    snprintf(new_node->data.log, MAX_LOG_LEN - 1, "%s", log);
+    // 本次打印距离该模块第一句打印的纳秒数
+    new_node->data.ns_from_first = now_ns - module_node->first_ns;
+    return new_node;
+}
+
+// 结点加入链表池尾部，更新模块最后打印时间
+static void queue_log_pool_node(LogNode *module_node, LogPoolNode *new_node, time_t timestamp, long long now_ns)
+{
+    module_node->last = timestamp;
+    module_node->last_ns = now_ns;
 
-    LogPoolNode *end_node = g_pool_head;
-    if (end_node == NULL)
+    if (g_pool_tail == NULL)
     {
         g_pool_head = new_node;
     }
     else
     {
-        while (end_node->next != NULL)
-        {
-            end_node = end_node->next;
-        }
-        end_node->next = new_node;
+        g_pool_tail->next = new_node;
     }
+    g_pool_tail = new_node;
 
     // 如果链表池达到阈值，则将缓存中的全部写入文件
-    if (++g_log_pool_size >= g_threshold)
+    if (++g_log_pool_count >= g_threshold)
     {
-        FILE *fp = fopen(g_log_path, "a+");
-        if (fp == NULL)
-        {
-            printf("open file failed.\n");
-            return;
-        }
-        LogNode *current_node = g_log_list_head;
-        while (current_node != NULL)
-        {
-            struct tm *first_time_local = localtime(&current_node->first);
-            char first_time_buffer[32];
-            strftime(first_time_buffer, sizeof(first_time_buffer), "%Y-%m-%d %H:%M:%S", first_time_local);
+        flush_log_pool();
+    }
+}
 
-            struct tm *last_time_local = localtime(&current_node->last);
-            char last_time_buffer[32];
-            strftime(last_time_buffer, sizeof(last_time_buffer), "%Y-%m-%d %H:%M:%S", last_time_local);
+// 格式化打印并加入链表池
+static void append_log_message(LogNode *module_node, time_t timestamp, long long now_ns, const char *format, va_list args)
+{
+    LogPoolNode *new_node = take_log_pool_node(module_node, timestamp, now_ns);
+    if (new_node == NULL)
+    {
+        return;
+    }
+    new_node->data.site = NULL;
+    vsnprintf(new_node->data.log, MAX_LOG_LEN - 1, format, args);
+    queue_log_pool_node(module_node, new_node, timestamp, now_ns);
+}
 
-            int diff_seconds = difftime(current_node->last, current_node->first);
+// 延迟格式化：只记录时间和原始参数，参数放不下时返回-1由调用方回退为立即格式化
+static int append_log_message_lazy(BootlogSite *site, time_t timestamp, long long now_ns, va_list args)
+{
+    LogPoolNode *new_node = take_log_pool_node(site->module_node, timestamp, now_ns);
+    if (new_node == NULL)
+    {
+        return 0;
+    }
+    // 与立即格式化的vsnprintf(log, MAX_LOG_LEN - 1, ...)使用相同的空间
+    if (capture_bootlog_args(&site->fmt, new_node->data.log, MAX_LOG_LEN - 1, args) < 0)
+    {
+        new_node->next = g_pool_free;
+        g_pool_free = new_node;
+        return -1;
+    }
+    new_node->data.site = site;
+    queue_log_pool_node(site->module_node, new_node, timestamp, now_ns);
+    return 0;
+}
 
-            fprintf(fp, "[%s][%s][%s][%d]%s\n", current_node->module, first_time_buffer,
-                    last_time_buffer, diff_seconds, current_node->dependence);
+// 设置BOOTLOG调用点的参数捕获方式(BOOTLOG_CAPTURE_EAGER/LAZY)
+void set_boot_log_capture_mode(int mode)
+{
+    g_boot_log_capture_mode = mode == BOOTLOG_CAPTURE_EAGER ? BOOTLOG_CAPTURE_EAGER : BOOTLOG_CAPTURE_LAZY;
+}
 
-            current_node = current_node->next;
+// 打印日志
+void log_message(const char *module, const char *dependence, const char *format, ...)
+{
+    // 获取当前时间戳，墙上时间只用于输出，耗时按单调时钟计算
+    const time_t timestamp = time(NULL);
+    const long long now_ns = log_mono_ns();
+
+    // 判断模块是否已经存在，若不存在则添加到模块列表中
+    LogNode *module_node = get_module_node(module, dependence, timestamp, now_ns);
+    if (module_node == NULL)
+    {
+        return;
+    }
+
+    va_list args;
+    va_start(args, format);
+    append_log_message(module_node, timestamp, now_ns, format, args);
+    va_end(args);
+}
+
+// BOOTLOG宏的运行时入口，按下标取调用点描述符，计数和模块查找都是O(1)
+void bootlog_site_log(unsigned int site_id, ...)
+{
+    BootlogSite *site = __start_bootlog_sites[site_id];
+    site->count++;
+
+    const time_t timestamp = time(NULL);
+    const long long now_ns = log_mono_ns();
+    if (site->module_node == NULL)
+    {
+        site->module_node = get_module_node(site->module, NULL, timestamp, now_ns);
+        if (site->module_node == NULL)
+        {
+            return;
         }
-        fclose(fp);
-        g_pool_head = NULL;
-        g_log_pool_size = 0;
     }
+    if (site->fmt.state == BOOTLOG_FMT_UNPARSED)
+    {
+        parse_bootlog_format(site->format, &site->fmt);
+    }
+
+    va_list args, eager_args;
+    va_start(args, site_id);
+    va_copy(eager_args, args);
+    if (g_boot_log_capture_mode != BOOTLOG_CAPTURE_LAZY || site->fmt.state != BOOTLOG_FMT_LAZY ||
+        append_log_message_lazy(site, timestamp, now_ns, args) != 0)
+    {
+        append_log_message(site->module_node, timestamp, now_ns, site->format, eager_args);
+    }
+    va_end(eager_args);
+    va_end(args);
+}
+
+// 将各调用点的打印次数写入文件，未执行过的调用点也列出
+void print_bootlog_sites()
+{
+    static const char *level_names[] = {"ERROR", "WARN", "INFO", "DEBUG"};
+    if (g_log_fp == NULL || __start_bootlog_sites == NULL)
+    {
+        return;
+    }
+    for (BootlogSite *const *p = __start_bootlog_sites; p < __stop_bootlog_sites; p++)
+    {
+        const BootlogSite *site = *p;
+        fprintf(g_log_fp, "[%ld][%s:%d][%s][%s][%lu]%s\n", (long)(p - __start_bootlog_sites), site->file, site->line,
+                site->module, level_names[site->level], site->count, site->format);
+    }
+    fflush(g_log_fp);
 }
 
-// 将日志中所有的模块信息打印到文件中
+// 将缓存中的打印和所有模块信息写入文件
 void print_module_info_to_file()
 {
-    FILE *fp = fopen(g_log_path, "a+");
-    if (fp == NULL)
+    flush_log_pool();
+    if (g_log_fp == NULL)
     {
-        printf("open file failed.\n");
         return;
     }
 
-    while (g_pool_head != NULL)
+    LogNode *current_node = g_log_list_head;
+    while (current_node != NULL)
     {
-        fprintf(fp, "[%ld][%s][%d] %s\n",
-                g_pool_head->data.timestamp, g_pool_head->data.module,
-                g_pool_head->data.seconds_from_first, g_pool_head->data.log);
-        LogPoolNode *current_node = g_pool_head;
-        g_pool_head = g_pool_head->next;
-        free(current_node);
+        struct tm first_time_local, last_time_local;
+        char first_time_buffer[32], last_time_buffer[32];
+        strftime(first_time_buffer, sizeof(first_time_buffer), "%Y-%m-%d %H:%M:%S",
+                 localtime_r(&current_node->first, &first_time_local));
+        strftime(last_time_buffer, sizeof(last_time_buffer), "%Y-%m-%d %H:%M:%S",
+                 localtime_r(&current_node->last, &last_time_local));
+
+        char diff[32];
+        format_log_elapsed(diff, sizeof(diff), current_node->last_ns - current_node->first_ns);
+
+        fprintf(g_log_fp, "[%s][%s][%s][%s]%s\n", current_node->module, first_time_buffer,
+                last_time_buffer, diff, current_node->dependence);
+
+        current_node = current_node->next;
+    }
+    if (g_module_dropped != 0)
+    {
+        fprintf(g_log_fp, "[dropped %lu logs: out of memory for module nodes]\n", g_module_dropped);
     }
-    fclose(fp);
+    fflush(g_log_fp);
 }
 
 // 释放内存，清空链表
 void cleanup_logger()
 {
-    while (g_log_list_head != NULL)
+    if (g_log_fp != NULL)
     {
-        LogNode *tmp = g_log_list_head;
-        g_log_list_head = g_log_list_head->next;
-        free(tmp);
+        fclose(g_log_fp);
+        g_log_fp = NULL;
     }
     free(g_log_path);
-
-    while (g_pool_head != NULL)
+    g_log_path = NULL;
+    free(g_pool_slab);
+    while (g_module_slab != NULL)
     {
-        LogPoolNode *tmp = g_pool_head;
-        g_pool_head = g_pool_head->next;
-        free(tmp);
+        LogModuleSlab *next = g_module_slab->next;
+        free(g_module_slab);
+        g_module_slab = next;
+    }
+    g_pool_slab = NULL;
+    g_pool_free = NULL;
+    g_module_free = NULL;
+    g_module_dropped = 0;
+    g_pool_head = NULL;
+    g_pool_tail = NULL;
+    g_log_list_head = NULL;
+    g_log_pool_count = 0;
+    // 缓存的模块结点随模块表一起释放
+    for (BootlogSite *const *p = __start_bootlog_sites; p < __stop_bootlog_sites; p++)
+    {
+        (*p)->module_node = NULL;
     }
 }
 
+#ifdef LOG_ALLOC_CHECK
+#include "log-alloc-check.h"
+
+static void alloc_check_log(int thread, int i)
+{
+    char module[MAX_MODULE_LEN];
+    snprintf(module, sizeof(module), "module%d", i % 16);
+    log_message(module, "dependence", "allocation check line %d", i);
+}
+#endif
+
 int main()
 {
+#ifdef LOG_ALLOC_CHECK
+    init_logger(1024, "/dev/null", 1000);
+    int ret = run_alloc_check(1, alloc_check_log, print_module_info_to_file);
+    cleanup_logger();
+    return ret;
+#endif
+
     init_logger(1024, NULL, 1024);
     log_message("TestModule", "TestDependencies", "This is a test\n");
+    for (int i = 0; i < 3; i++)
+    {
+        BOOTLOG("TestModule", "probe %d done", i);
+    }
     print_module_info_to_file();
+    print_bootlog_sites();
     cleanup_logger();
     return 0;
 }
\ No newline at end of file
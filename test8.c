@@ -6,34 +6,115 @@
 #include <time.h>
 #include <sys/time.h>
 #include <math.h>
+#include "bootlog-format.h"
 
 #define LOG_BUFFER_SIZE 512           // 打印信息缓冲池大小
 #define MAX_MODULE_NAME_LEN 32        // 模块名最大长度
 #define BOOT_LOG_PATH "/home/boot.log"// 日志文件路径
 #define LOG_FLUSH_THRESHOLD 200       // 缓冲池自动写入文件的阈值
+#define MAX_MODULE_NUM 64             // 每块模块结点数，模块数超出时再按块扩展
+#define MAX_DEP_INFO_LEN 64           // 模块依赖信息最大长度
+#define LOG_FILE_BUF_SIZE 4096        // 日志文件的stdio缓冲区大小
+
+// 打印级别，记录在调用点描述符中
+#define BOOTLOG_LEVEL_ERROR 0
+#define BOOTLOG_LEVEL_WARN 1
+#define BOOTLOG_LEVEL_INFO 2
+#define BOOTLOG_LEVEL_DEBUG 3
+
+// BOOTLOG调用点的参数捕获方式
+#define BOOTLOG_CAPTURE_EAGER 0 // 调用方立即格式化
+#define BOOTLOG_CAPTURE_LAZY 1  // 调用方只拷贝原始参数，写文件时再格式化
 
 #define min(x, y) ((x) < (y) ? (x) : (y))
+#define max(x, y) ((x) > (y) ? (x) : (y))
 
 // 定义打印信息结构体
 struct log_message {
-    char *message;                  // 要记录的打印信息
+    char *message;                  // 要记录的打印信息，指向init时分配的消息区；延迟格式化时存放捕获的参数
+    struct bootlog_site *site;      // 延迟格式化的调用点，NULL表示message已是格式化好的文本
+    unsigned long time;             // 延迟格式化时记录的打印时间
+    double elapsed;                 // 延迟格式化时记录的距第一条打印的秒数
     struct log_message* next;       // 下一条打印信息
 };
 
 // 模块链表节点
 struct module_node {
     char name[MAX_MODULE_NAME_LEN];         // 模块名称
-    char *dep_info;                         // 模块依赖信息字符串
+    char dep_info[MAX_DEP_INFO_LEN];        // 模块依赖信息字符串
     time_t first_log_time, last_log_time;   // 模块第一条打印时间和最后一条打印时间
     struct module_node *next;               // 下一个模块节点
 };
 
+// 模块结点按块分配，块之间串成链表，release时一起释放
+struct module_node_slab {
+    struct module_node_slab *next;
+    struct module_node nodes[MAX_MODULE_NUM];
+};
+
+// 调用点描述符，由BOOTLOG宏在编译期生成，指向它的指针放入bootlog_sites段，运行时按下标访问
+// 段内只放指针，编译器对较大的静态对象做额外对齐(以及ASan加的保护区)不会打乱下标
+struct bootlog_site {
+    const char *module;              // 模块名
+    const char *format;              // 格式串
+    const char *file;                // 源文件
+    int line;                        // 行号
+    int level;                       // 打印级别
+    unsigned long count;             // 该调用点的打印次数
+    struct module_node *module_node; // 首次打印后缓存的模块结点，之后不再按模块名查找
+    bootlog_fmt_t fmt;               // 首次打印时解析格式串的结果，之后按此捕获和格式化参数
+};
+
+// 链接器为bootlog_sites段生成的起止地址，程序中没有调用点时为空
+extern struct bootlog_site *const __start_bootlog_sites[] __attribute__((weak));
+extern struct bootlog_site *const __stop_bootlog_sites[] __attribute__((weak));
+
+void bootlog_site_log(unsigned int site_id, ...);
+
+// 按调用点打印：模块名、格式串、文件行号在编译期确定，运行时只传调用点下标和参数
+// if (0) printf只用于让编译器检查格式串与参数是否匹配
+#define BOOTLOG_AT(lvl, mod, fmt, ...) do { \
+    static struct bootlog_site bootlog_site_ = {mod, fmt, __FILE__, __LINE__, lvl, 0, NULL, {0}}; \
+    static struct bootlog_site *const bootlog_site_ptr_ \
+        __attribute__((section("bootlog_sites"), used, aligned(sizeof(void *)))) = &bootlog_site_; \
+    if (0) { \
+        printf(fmt, ##__VA_ARGS__); \
+    } \
+    bootlog_site_log(&bootlog_site_ptr_ - __start_bootlog_sites, ##__VA_ARGS__); \
+} while (0)
+#define BOOTLOG(mod, fmt, ...) BOOTLOG_AT(BOOTLOG_LEVEL_INFO, mod, fmt, ##__VA_ARGS__)
+
 static struct module_node *module_list_head = NULL; // 模块链表头
 static struct log_message *log_msg_buffer = NULL;   // 打印信息缓冲池
+static struct log_message *log_msg_tail = NULL;     // 缓冲池末尾，追加时不用遍历
 static unsigned int log_msg_count = 0;             // 打印信息数量计数器
 static unsigned int log_buffer_size = LOG_BUFFER_SIZE;   // 打印信息缓存池大小
-static char *boot_log_path = BOOT_LOG_PATH;              // 日志文件路径
+static const char *boot_log_path = BOOT_LOG_PATH;              // 日志文件路径
 static unsigned int log_flush_threshold = LOG_FLUSH_THRESHOLD;  // 缓冲区日志数目达到该值后触发自动写入
+static FILE *boot_log_fp = NULL;                         // 日志文件，init时打开
+
+// 打印信息结点、消息内容和第一块模块结点在init时分配，打印时只从空闲链表中取；
+// 只有出现新模块且当前块用完时才再分配一块
+static struct log_message *log_msg_slab = NULL;
+static char *log_text_slab = NULL;
+static struct log_message *log_msg_free = NULL;
+static struct module_node_slab *module_slab = NULL;
+static unsigned int module_count = 0;          // 当前块已用的模块结点数
+static unsigned long module_dropped = 0;       // 扩展模块结点失败而没有统计的模块数
+static char *log_render_buf = NULL; // 写文件时格式化延迟记录的缓冲区，与消息区一起分配
+static int boot_log_capture_mode = BOOTLOG_CAPTURE_LAZY;
+
+// 分配一块模块结点作为当前块，失败时返回-1
+static int grow_module_slab() {
+    struct module_node_slab *slab = (struct module_node_slab *)calloc(1, sizeof(struct module_node_slab));
+    if (slab == NULL) {
+        return -1;
+    }
+    slab->next = module_slab;
+    module_slab = slab;
+    module_count = 0;
+    return 0;
+}
 
 // 刷新并写入所有日志
 void flush_boot_log() {
@@ -41,33 +122,151 @@ void flush_boot_log() {
         return;
     }
 
-    // 打开或创建日志文件
-    FILE *fp = fopen(boot_log_path, "a");
-    if (fp == NULL) {
-        return;
-    }
-
-    // 遍历所有打印信息，按照规定格式写入日志文件，并释放相关内存空间
+    // 遍历所有打印信息，按照规定格式写入日志文件，并将结点归还空闲链表
     struct log_message *tmp_msg = log_msg_buffer;
     while (tmp_msg != NULL) {
-        fwrite(tmp_msg->message, strlen(tmp_msg->message), 1, fp);
-        fputc('\n', fp);
+        if (boot_log_fp != NULL && tmp_msg->site != NULL) {
+            // 延迟格式化的记录在这里才拼接前缀和内容
+            int len = snprintf(log_render_buf, log_buffer_size, "[%ld][%s][%.3f]",
+                               tmp_msg->time, tmp_msg->site->module, tmp_msg->elapsed);
+            if (len < (int)log_buffer_size) {
+                len += render_bootlog_args(tmp_msg->site->format, &tmp_msg->site->fmt, tmp_msg->message, log_render_buf + len, log_buffer_size - len);
+            } else {
+                len = log_buffer_size - 1;
+            }
+            fwrite(log_render_buf, len, 1, boot_log_fp);
+            fputc('\n', boot_log_fp);
+        } else if (boot_log_fp != NULL) {
+            fwrite(tmp_msg->message, strlen(tmp_msg->message), 1, boot_log_fp);
+            fputc('\n', boot_log_fp);
+        }
         struct log_message *next = tmp_msg->next;
-        free(tmp_msg->message);
-        free(tmp_msg);
+        tmp_msg->next = log_msg_free;
+        log_msg_free = tmp_msg;
         tmp_msg = next;
     }
 
     // 重置缓冲池数据
     log_msg_buffer = NULL;
+    log_msg_tail = NULL;
     log_msg_count = 0;
 
-    fclose(fp);
+    if (boot_log_fp != NULL) {
+        fflush(boot_log_fp);
+    }
+}
+
+// 查找模块结点，不存在时新建；扩展模块结点失败时计数并返回NULL，该模块的打印照常写入但没有统计
+static struct module_node *get_module_node(const char *module_name, time_t now) {
+    struct module_node *cur_module = module_list_head;
+    struct module_node *prev_module = NULL;
+    while (cur_module != NULL && strcmp(cur_module->name, module_name) != 0) {
+        prev_module = cur_module;
+        cur_module = cur_module->next;
+    }
+    if (cur_module == NULL) {
+        if (module_count >= MAX_MODULE_NUM && grow_module_slab() != 0) {
+            module_dropped++;
+            return NULL;
+        }
+        cur_module = &module_slab->nodes[module_count++];
+        memset(cur_module, 0, sizeof(struct module_node));
+        snprintf(cur_module->name, MAX_MODULE_NAME_LEN, "%s", module_name);
+        cur_module->first_log_time = now;
+        if (prev_module == NULL) {
+            module_list_head = cur_module;
+        } else {
+            prev_module->next = cur_module;
+        }
+    }
+    return cur_module;
+}
+
+// 从空闲链表取一个打印信息结点，没有空闲结点时先写入文件
+static struct log_message *take_log_message() {
+    if (log_msg_free == NULL) {
+        flush_boot_log();
+    }
+    struct log_message *msg = log_msg_free;
+    log_msg_free = msg->next;
+    msg->next = NULL;
+    msg->site = NULL;
+    return msg;
+}
+
+// 本条打印距离第一条打印的秒数
+static double boot_log_elapsed(unsigned long now) {
+    return log_msg_count == 0 || module_list_head == NULL ? 0.0 : 1.0 * (now - module_list_head->first_log_time);
+}
+
+// 插入到缓冲池末尾，数量达到自动刷新阈值时写入文件
+static void queue_log_message(struct log_message *msg) {
+    if (log_msg_tail == NULL) {
+        log_msg_buffer = msg;
+    } else {
+        log_msg_tail->next = msg;
+    }
+    log_msg_tail = msg;
+    log_msg_count++;
+
+    if (log_msg_count >= log_flush_threshold) {
+        flush_boot_log();
+    }
+}
+
+// 更新模块状态信息；dependency为NULL时保留原有依赖信息
+static void touch_module_node(struct module_node *module, const char *dependency, unsigned long now) {
+    if (module == NULL) {
+        return;
+    }
+    module->first_log_time = min(module->first_log_time, now);
+    module->last_log_time = max(module->last_log_time, now);
+    if (dependency != NULL) {
+        snprintf(module->dep_info, MAX_DEP_INFO_LEN, "%s", dependency);
+    }
+}
+
+// 格式化一条打印加入缓冲池，并更新模块状态
+static void append_boot_log(struct module_node *module, const char *module_name, const char *dependency,
+                            unsigned long now, const char *format, va_list args) {
+    struct log_message *new_log_msg = take_log_message();
+
+    // 根据传入的格式化字符串构造打印信息
+    char *msg = new_log_msg->message;
+    int len = snprintf(msg, log_buffer_size, "[%ld][%s][%.3f]", now, module_name, boot_log_elapsed(now));
+    if (len < (int)log_buffer_size) {
+        vsnprintf(msg + len, log_buffer_size - len, format, args);
+    }
+
+    queue_log_message(new_log_msg);
+    touch_module_node(module, dependency, now);
+}
+
+// 延迟格式化：只记录时间和原始参数，参数放不下时返回-1由调用方回退为立即格式化
+static int append_boot_log_lazy(struct bootlog_site *site, unsigned long now, va_list args) {
+    struct log_message *new_log_msg = take_log_message();
+    if (capture_bootlog_args(&site->fmt, new_log_msg->message, log_buffer_size, args) < 0) {
+        new_log_msg->next = log_msg_free;
+        log_msg_free = new_log_msg;
+        return -1;
+    }
+    new_log_msg->site = site;
+    new_log_msg->time = now;
+    new_log_msg->elapsed = boot_log_elapsed(now);
+
+    queue_log_message(new_log_msg);
+    touch_module_node(site->module_node, NULL, now);
+    return 0;
+}
+
+// 设置BOOTLOG调用点的参数捕获方式(BOOTLOG_CAPTURE_EAGER/LAZY)
+void set_boot_log_capture_mode(int mode) {
+    boot_log_capture_mode = mode == BOOTLOG_CAPTURE_EAGER ? BOOTLOG_CAPTURE_EAGER : BOOTLOG_CAPTURE_LAZY;
 }
 
 // 打印信息记录接口，将所有打印先记录到缓存中
 void module_boot_log(const char *module_name, const char *dependency, const char *format, ...) {
-    if (log_msg_buffer == NULL) {
+    if (log_msg_slab == NULL) {
         return;
     }
 
@@ -76,61 +275,53 @@ void module_boot_log(const char *module_name, const char *dependency, const char
     gettimeofday(&tv, NULL);
     unsigned long now = tv.tv_sec;
 
-    // 根据传入的格式化字符串构造打印信息
     va_list args;
     va_start(args, format);
-    char *msg = (char *)calloc(log_buffer_size, sizeof(char));
-    int len = snprintf(msg, log_buffer_size,
-                       "[%ld][%s][%.3f]",
-                       now, module_name, log_msg_count == 0 ? 0.0 : 1.0 * (now - module_list_head->first_log_time));
-    len += vsnprintf(msg + len, log_buffer_size - len, format, args);
-
-    // 构造完整的打印信息结构体，插入到缓冲池末尾
-    struct log_message *new_log_msg = (struct log_message *)malloc(sizeof(struct log_message));
-    new_log_msg->message = msg;
-    new_log_msg->next = NULL;
-    if (log_msg_buffer == NULL) {
-        log_msg_buffer = new_log_msg;
-    } else {
-        struct log_message *tmp = log_msg_buffer;
-        while (tmp->next != NULL) {
-            tmp = tmp->next;
-        }
-        tmp->next = new_log_msg;
+    append_boot_log(get_module_node(module_name, now), module_name, dependency != NULL ? dependency : "", now, format, args);
+    va_end(args);
+}
+
+// BOOTLOG宏的运行时入口，按下标取调用点描述符，计数和模块查找都是O(1)
+void bootlog_site_log(unsigned int site_id, ...) {
+    struct bootlog_site *site = __start_bootlog_sites[site_id];
+    site->count++;
+    if (log_msg_slab == NULL) {
+        return;
     }
-    log_msg_count++;
 
-    // 如果打印信息数量达到自动刷新阈值，则自动将缓冲池数据写入文件
-    if (log_msg_count >= log_flush_threshold) {
-        flush_boot_log();
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    unsigned long now = tv.tv_sec;
+    if (site->module_node == NULL) {
+        site->module_node = get_module_node(site->module, now);
+    }
+    if (site->fmt.state == BOOTLOG_FMT_UNPARSED) {
+        parse_bootlog_format(site->format, &site->fmt);
     }
 
+    va_list args, eager_args;
+    va_start(args, site_id);
+    va_copy(eager_args, args);
+    if (boot_log_capture_mode != BOOTLOG_CAPTURE_LAZY || site->fmt.state != BOOTLOG_FMT_LAZY ||
+        append_boot_log_lazy(site, now, args) != 0) {
+        append_boot_log(site->module_node, site->module, NULL, now, site->format, eager_args);
+    }
+    va_end(eager_args);
     va_end(args);
+}
 
-    // 更新/新增模块状态信息
-    struct module_node *cur_module = module_list_head;
-    struct module_node *prev_module = NULL;
-    while (cur_module != NULL && strcmp(cur_module->name, module_name) != 0) {
-        prev_module = cur_module;
-        cur_module = cur_module->next;
-    }
-    if (cur_module == NULL) {
-        cur_module = (struct module_node *)malloc(sizeof(struct module_node));
-        memset(cur_module, 0, sizeof(struct module_node));
-        memcpy(cur_module->name, module_name, strlen(module_name) + 1);
-        if (prev_module == NULL) {
-            module_list_head = cur_module;
-        } else {
-            prev_module->next = cur_module;
-        }
+// 将各调用点的打印次数写入日志文件，未执行过的调用点也列出
+void print_bootlog_sites() {
+    static const char *level_names[] = {"ERROR", "WARN", "INFO", "DEBUG"};
+    if (boot_log_fp == NULL || __start_bootlog_sites == NULL) {
+        return;
     }
-    cur_module->first_log_time = min(cur_module->first_log_time, now);
-    cur_module->last_log_time = max(cur_module->last_log_time, now);
-    if (cur_module->dep_info != NULL) {
-        free(cur_module->dep_info);
+    for (struct bootlog_site *const *p = __start_bootlog_sites; p < __stop_bootlog_sites; p++) {
+        const struct bootlog_site *site = *p;
+        fprintf(boot_log_fp, "[%ld][%s:%d][%s][%s][%lu]%s\n", (long)(p - __start_bootlog_sites), site->file, site->line,
+                site->module, level_names[site->level], site->count, site->format);
     }
-    cur_module->dep_info = (char *)calloc(strlen(dependency) + 1, sizeof(char));
-    memcpy(cur_module->dep_info, dependency, strlen(dependency));
+    fflush(boot_log_fp);
 }
 
 // 初始化启动日志记录组件，设置缓存池大小、日志文件路径和自动写入阈值
@@ -138,6 +329,56 @@ void init_boot_log(unsigned int buffer_size, const char *path, unsigned int flus
     log_buffer_size = buffer_size > 0 ? buffer_size : LOG_BUFFER_SIZE;
     boot_log_path = path != NULL ? path : BOOT_LOG_PATH;
     log_flush_threshold = flush_threshold > 0 ? flush_threshold : LOG_FLUSH_THRESHOLD;
+
+    // 缓冲池最多缓存log_flush_threshold条，按此一次性分配结点和消息区
+    log_msg_slab = (struct log_message *)calloc(log_flush_threshold, sizeof(struct log_message));
+    log_text_slab = (char *)calloc(log_flush_threshold + 1, log_buffer_size);
+    if (log_msg_slab == NULL || log_text_slab == NULL || grow_module_slab() != 0) {
+        free(log_msg_slab);
+        free(log_text_slab);
+        log_msg_slab = NULL;
+        log_text_slab = NULL;
+        return;
+    }
+    for (unsigned int i = 0; i < log_flush_threshold; i++) {
+        log_msg_slab[i].message = log_text_slab + (size_t)i * log_buffer_size;
+        log_msg_slab[i].next = i + 1 < log_flush_threshold ? &log_msg_slab[i + 1] : NULL;
+    }
+    log_msg_free = log_msg_slab;
+    log_render_buf = log_text_slab + (size_t)log_flush_threshold * log_buffer_size;
+
+    // 打开或创建日志文件，使用静态缓冲区，写文件时不再分配内存
+    static char log_file_buf[LOG_FILE_BUF_SIZE];
+    boot_log_fp = fopen(boot_log_path, "a");
+    if (boot_log_fp != NULL) {
+        setvbuf(boot_log_fp, log_file_buf, _IOFBF, LOG_FILE_BUF_SIZE);
+    }
+}
+
+// 写入剩余日志，关闭文件并释放init时分配的内存
+void release_boot_log() {
+    flush_boot_log();
+    if (boot_log_fp != NULL) {
+        fclose(boot_log_fp);
+        boot_log_fp = NULL;
+    }
+    free(log_msg_slab);
+    free(log_text_slab);
+    while (module_slab != NULL) {
+        struct module_node_slab *next = module_slab->next;
+        free(module_slab);
+        module_slab = next;
+    }
+    log_msg_slab = NULL;
+    log_text_slab = NULL;
+    log_msg_free = NULL;
+    module_list_head = NULL;
+    module_count = 0;
+    module_dropped = 0;
+    // 缓存的模块结点随模块表一起释放
+    for (struct bootlog_site *const *p = __start_bootlog_sites; p < __stop_bootlog_sites; p++) {
+        (*p)->module_node = NULL;
+    }
 }
 
 // 将模块状态信息写入日志文件
@@ -146,26 +387,88 @@ void print_module_statistics() {
         return;
     }
 
-    FILE *fp = fopen(boot_log_path, "a");
-    if (fp == NULL) {
+    if (boot_log_fp == NULL) {
         return;
     }
 
     // 遍历每个模块，并将其打印信息写入日志文件中
     struct module_node *cur_module = module_list_head;
-    char *buffer = (char *)calloc(log_buffer_size, sizeof(char));
     while (cur_module != NULL) {
-        int len = snprintf(buffer, log_buffer_size, "[%s][%ld][%ld][%.3f][%s]\n",
-                           cur_module->name, cur_module->first_log_time, cur_module->last_log_time,
-                           cur_module->last_log_time - cur_module->first_log_time, cur_module->dep_info);
-        fwrite(buffer, len, 1, fp);
+        fprintf(boot_log_fp, "[%s][%ld][%ld][%.3f][%s]\n",
+                cur_module->name, cur_module->first_log_time, cur_module->last_log_time,
+                difftime(cur_module->last_log_time, cur_module->first_log_time), cur_module->dep_info);
         cur_module = cur_module->next;
     }
-    fclose(fp);
-    free(buffer);
+    if (module_dropped != 0) {
+        fprintf(boot_log_fp, "[dropped statistics of %lu modules: out of memory for module nodes]\n", module_dropped);
+    }
+    fflush(boot_log_fp);
+}
+
+#ifdef LOG_ALLOC_CHECK
+#include "log-alloc-check.h"
+
+static void alloc_check_log(int thread, int i) {
+    char module[MAX_MODULE_NAME_LEN];
+    snprintf(module, sizeof(module), "module%d", i % 16);
+    module_boot_log(module, "dep info", "[INFO] allocation check line %d", i);
+}
+
+static void alloc_check_flush() {
+    flush_boot_log();
+    print_module_statistics();
+}
+#endif
+
+#ifdef LOG_CAPTURE_BENCH
+#define BENCH_CAPTURE_CALLS 100000
+#define BENCH_CAPTURE_ROUNDS 10
+
+static double bench_elapsed_ns(const struct timespec *beg, const struct timespec *end) {
+    return (end->tv_sec - beg->tv_sec) * 1e9 + (end->tv_nsec - beg->tv_nsec);
+}
+
+// 立即格式化与延迟格式化下，调用方每次BOOTLOG的耗时和写文件时每条的耗时
+static void run_capture_bench() {
+    static const char *names[] = {"eager", "lazy"};
+    printf("%-8s%-14s%-14s\n", "mode", "caller ns", "flush ns");
+    for (int mode = BOOTLOG_CAPTURE_EAGER; mode <= BOOTLOG_CAPTURE_LAZY; mode++) {
+        double caller_ns = 0, flush_ns = 0;
+        // 阈值等于每轮打印数，打印过程中不触发写文件
+        init_boot_log(0, "/dev/null", BENCH_CAPTURE_CALLS + 1);
+        set_boot_log_capture_mode(mode);
+        for (int r = 0; r < BENCH_CAPTURE_ROUNDS; r++) {
+            struct timespec beg, end;
+            clock_gettime(CLOCK_MONOTONIC, &beg);
+            for (int i = 0; i < BENCH_CAPTURE_CALLS; i++) {
+                BOOTLOG("bench", "[INFO] device %s probe %d took %.3f ms, status 0x%x", "mmc0", i, i * 0.125, i & 0xff);
+            }
+            clock_gettime(CLOCK_MONOTONIC, &end);
+            caller_ns += bench_elapsed_ns(&beg, &end);
+            clock_gettime(CLOCK_MONOTONIC, &beg);
+            flush_boot_log();
+            clock_gettime(CLOCK_MONOTONIC, &end);
+            flush_ns += bench_elapsed_ns(&beg, &end);
+        }
+        release_boot_log();
+        printf("%-8s%-14.1f%-14.1f\n", names[mode], caller_ns / (BENCH_CAPTURE_CALLS * BENCH_CAPTURE_ROUNDS),
+               flush_ns / (BENCH_CAPTURE_CALLS * BENCH_CAPTURE_ROUNDS));
+    }
 }
+#endif
 
 int main(int argc, char *argv[]) {
+#ifdef LOG_ALLOC_CHECK
+    init_boot_log(256, "/dev/null", 1000);
+    int ret = run_alloc_check(1, alloc_check_log, alloc_check_flush);
+    release_boot_log();
+    return ret;
+#endif
+#ifdef LOG_CAPTURE_BENCH
+    run_capture_bench();
+    return 0;
+#endif
+
     // 初始化启动日志记录模块
     init_boot_log(300, "/home/log/boot.log", 500);
 
@@ -173,6 +476,10 @@ int main(int argc, char *argv[]) {
     module_boot_log("module1", "dep info 1", "[INFO] This is a test message from module1");
     module_boot_log("module2", "dep info 2", "[ERROR] Something went wrong in module2");
     module_boot_log("module1", "dep info 1", "[DEBUG] Debug info from module1");
+    for (int i = 0; i < 3; i++) {
+        BOOTLOG("module2", "[INFO] module2 probe %d done", i);
+    }
+    BOOTLOG_AT(BOOTLOG_LEVEL_ERROR, "module3", "[ERROR] module3 failed: %s", "timeout");
 
     // 刷新所有读取到的日志信息
     flush_boot_log();
@@ -180,5 +487,9 @@ int main(int argc, char *argv[]) {
     // 输出所有模块的状态信息
     print_module_statistics();
 
+    // 输出各调用点的打印次数
+    print_bootlog_sites();
+
+    release_boot_log();
     return 0;
 }
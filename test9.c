@@ -1,3 +1,4 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
@@ -5,87 +6,464 @@
 #include <string.h>
 #include <time.h>
 #include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
 
 #define MAX_MODULE_NAME_LEN 256
-#define MAX_DEPENDENCIES_LEN 1024
 #define MAX_LOG_ENTRY_LEN 512
 #define MAX_LOG_FILE_PATH_LEN 128
-#define DEFAULT_LOG_ENTRIES_CAPACITY 500
+#define MODULE_TABLE_INIT_SIZE 64 // 模块哈希表初始槽数，须为2的幂
+#define MAX_MODULE_NUM 4096       // 最多注册的模块数，模块句柄取值[0, MAX_MODULE_NUM)
+#define DEFAULT_LOG_BUFFER_CAPACITY (256 * 1024) // 日志缓冲区字节数
 #define DEFAULT_LOG_FILE_PATH "./boot.log"
-#define DEFAULT_LOG_FLUSH_THRESHOLD 250
+#define DEFAULT_LOG_FLUSH_THRESHOLD (128 * 1024)  // 积压达到该字节数时触发写文件
+#define DEFAULT_LOG_FLUSH_IDLE_MS 100
+#define DEFAULT_LOG_BLOCK_TIMEOUT_MS 50 // 阻塞策略下生产者最多等待的时间
+#define LOG_STAGING_BUF_LEN (64 * 1024) // 批量写文件的暂存区大小
+#define LOG_URING_ENTRIES 8             // io_uring提交队列深度
+#define LOG_URING_SUBMIT_RETRIES 16     // io_uring_enter返回EAGAIN/EBUSY时的重试次数，EINTR不计
+#define DEFAULT_LOG_MMAP_GROWTH_STEP (1024 * 1024) // 映射模式下每次预分配的文件长度
+#define LOG_MMAP_WINDOW_LEN (4 * 1024 * 1024)      // 映射窗口大小，写满后滑动，限制内存占用
+#define MAX_LOG_RECORD_LEN (MAX_MODULE_NAME_LEN + MAX_LOG_ENTRY_LEN + 64) // 单条渲染后日志的最大长度
+#define DEFAULT_LOG_RETAINED_SEGMENTS 4 // 分段时保留的旧段数
 
+// 写文件前的流式压缩(LZ77)：流头 + 若干帧，每帧是一个暂存区的内容，匹配可引用同一流中之前的帧
+// 帧头为原文长度、压缩后长度、压缩数据校验和，文件在帧中间被截断时之前的帧仍可解压
+#define LOG_LZ_MAGIC 0x315a4c42u // "BLZ1"
+#define LOG_LZ_STREAM_HDR_LEN 8  // magic + 窗口大小
+#define LOG_LZ_FRAME_HDR_LEN 12
+#define LOG_LZ_FRAME_STORED 0x80000000u // 压缩后不更小时按原文存放
+#define LOG_LZ_WINDOW (64 * 1024)      // 匹配距离上限，解压端保留同样长度的历史
+#define LOG_LZ_HASH_BITS 14
+#define LOG_LZ_MIN_MATCH 4
+#define LOG_LZ_MAX_FRAME_LEN(len) (LOG_LZ_STREAM_HDR_LEN + LOG_LZ_FRAME_HDR_LEN + (len) + (len) / 255 + 16)
+
+// 写文件后端
+#define LOG_BACKEND_SYNC 0     // 同步write
+#define LOG_BACKEND_IO_URING 1 // io_uring异步提交，上一批写入时继续渲染下一批
+#define LOG_BACKEND_MMAP 2     // 预分配文件并映射，日志直接渲染进映射区，外部工具可实时读取
+
+// 写线程状态，生产者据此决定是否敲门铃唤醒写线程
+#define WRITER_BUSY 0         // 正在处理，无需唤醒
+#define WRITER_WAIT_EMPTY 1   // 缓冲区为空，无限期休眠
+#define WRITER_WAIT_PARTIAL 2 // 有未满阈值的日志，等待空闲超时
+
+// 缓冲区满时的处理策略，在延迟和完整性之间取舍
+#define LOG_OVERFLOW_DROP_NEWEST 0     // 丢弃新日志，生产者不等待
+#define LOG_OVERFLOW_OVERWRITE_OLDEST 1 // 丢弃最旧的未写日志，保留最新的现场
+#define LOG_OVERFLOW_BLOCK 2           // 唤醒写线程并等待空间，超时后丢弃
+#define LOG_OVERFLOW_SPILL 3           // 生产者自己同步写到<路径>.spill，不丢日志
+
+// 日志文件格式
+#define LOG_FORMAT_TEXT 0   // [年月日时分秒][模块名][秒数]内容
+#define LOG_FORMAT_BINARY 1 // 原始时间戳/模块id/纳秒数/内容，由bootlog-decode离线渲染
+
+// 距该模块第一句打印的时间的输出精度，取值为小数位数
+#define LOG_TIME_PRECISION_S 0
+#define LOG_TIME_PRECISION_MS 3
+#define LOG_TIME_PRECISION_US 6
+
+// 二进制记录类型，每条记录为4字节头(类型+记录体长度)加记录体，字段均为本机字节序
+#define BIN_REC_SESSION 1 // 会话开始：magic + version，模块id从此重新编号
+#define BIN_REC_MODULE 2  // 模块定义：uint16 id + 模块名
+#define BIN_REC_LOG 3     // 日志：int64 时间戳 + uint16 模块id + int64 纳秒数 + 内容
+#define BIN_LOG_MAGIC 0x474f4c42u // "BLOG"
+#define BIN_LOG_VERSION 2 // 版本1的日志记录为int32秒数
+#define BIN_REC_HDR_LEN 4
+
+// 持久环形缓冲区文件(MAP_SHARED)，进程崩溃或挂死后由bootlog-recover取出未写出的记录
+#define LOG_RING_MAGIC 0x474e5242u // "BRNG"
+#define LOG_RING_VERSION 1
+#define LOG_RING_HDR_LEN 4096                // 文件头占一页
+#define LOG_RING_MODULE_AREA_LEN (64 * 1024) // 模块名区，紧跟文件头，之后是记录区
+#define LOG_RING_STATE_ACTIVE 1              // 正在使用，进程异常退出后保持此状态
+#define LOG_RING_STATE_CLEAN 2               // 已正常释放，记录都已写入日志文件
+
+// 变长日志记录，按实际内容长度占用缓冲区，8字节对齐
+// 生产者只记录原始数据，时间和前缀的格式化推迟到写线程
 typedef struct log_entry
 {
-    char timestr[20];
-    char module_name[MAX_MODULE_NAME_LEN];
-    int seconds_from_first_log;
-    char log_content[MAX_LOG_ENTRY_LEN];
+    _Atomic uint32_t size; // 记录总字节数，0表示空闲；带LOG_RECORD_BUSY标志的是已预留未提交，带LOG_RECORD_PAD标志的是回绕前的填充
+    uint16_t log_len;
+    uint16_t module_id; // 与module相同，持久环形缓冲区中的记录靠它在进程外找回模块
+    time_t timestamp; // 墙上时间，只用于可读的前缀
+    struct module_info *module;
+    int64_t mono_ns;  // 单调时钟纳秒，渲染时减去模块第一句打印的时间
+    char log_content[];
 } log_entry_t;
 
+#define LOG_RECORD_PAD 0x80000000u
+#define LOG_RECORD_BUSY 0x40000000u // 预留后立即写入，崩溃后恢复工具可据此跳过未提交的记录
+#define LOG_RECORD_ALIGN 8
+#define LOG_RECORD_SIZE(len) ((offsetof(log_entry_t, log_content) + (len) + LOG_RECORD_ALIGN - 1) & ~(size_t)(LOG_RECORD_ALIGN - 1))
+#define MIN_LOG_BUFFER_CAPACITY (LOG_RECORD_SIZE(MAX_LOG_ENTRY_LEN) * 4)
+
 typedef struct module_info
 {
     char module_name[MAX_MODULE_NAME_LEN];
-    time_t first_log_time;
-    time_t last_log_time;
-    char dependencies[MAX_DEPENDENCIES_LEN];
+    uint32_t hash;  // 模块名哈希，查找和扩容时免去重复计算
+    _Atomic uint32_t deps_hash; // 最近一次合并的依赖串的哈希，0表示尚未合并；依赖串相同时打印不必加锁
+    int id;         // 模块编号，二进制记录中代替模块名
+    bool announced; // 是否已在当前二进制文件中写出模块定义(仅写线程访问)
+    _Atomic int64_t first_log_ns; // 单调时钟纳秒，0表示尚未打印；按句柄打印时不加锁，原子更新
+    _Atomic int64_t last_log_ns;
+    uint64_t dependencies[MAX_MODULE_NUM / 64]; // 依赖模块id集合(位图)，输出时才拼接为逗号分隔的字符串
+    atomic_size_t overflow_count; // 缓冲区满时被丢弃(或溢写)的日志条数
+    size_t overflow_reported;     // 已在汇总中报告的条数(仅写线程访问)
+    struct log_ring_module *ring_module; // 持久环形缓冲区中的模块项，未启用或模块名区已满时为NULL
     struct module_info *next;
 } module_info_t;
 
+// 环形缓冲区头部，读写索引为单调递增的字节位置，取模得到缓冲区偏移
+// 持久模式下位于映射文件开头，恢复工具从read_index起扫描到write_index
+typedef struct log_ring_header
+{
+    uint32_t magic;
+    uint32_t version;
+    _Atomic uint32_t state;  // LOG_RING_STATE_*
+    uint32_t record_hdr_len; // 记录头长度，恢复工具据此校验记录布局
+    int32_t pid;
+    uint32_t reserved;
+    uint64_t capacity;        // 记录区字节数
+    uint64_t module_area_off; // 模块名区在文件中的偏移
+    uint64_t module_area_len;
+    uint64_t arena_off;                 // 记录区在文件中的偏移
+    _Atomic uint64_t module_area_used;  // 模块名区已用字节数，模块项写完后才更新
+    atomic_size_t read_index;  // 读取日志的位置，之前的记录都已写入日志文件(持有g_log_buf_mutex时修改)
+    atomic_size_t write_index; // 写入日志的位置(生产者原子预留)
+} log_ring_header_t;
+
+// 模块名区中的一项，模块登记时追加，8字节对齐
+typedef struct log_ring_module
+{
+    _Atomic int64_t first_log_ns; // 与module_info_t中的相同，恢复时计算耗时
+    uint16_t id;
+    uint16_t name_len;
+    char name[];
+} log_ring_module_t;
+
+// 多生产者单消费者字节环形缓冲区
 typedef struct log_buffer
 {
-    log_entry_t *entries; // 日志内容数组
-    int capacity;         // 日志缓冲区容量
-    int count;            // 当前存储日志数量(未保存文件的)
-    int read_index;       // 读取日志的索引
-    int write_index;      // 写入日志的索引
+    char *arena;              // 日志记录区
+    size_t capacity;          // 日志缓冲区字节数
+    log_ring_header_t *ring;  // 读写索引所在的头部，持久模式下指向映射文件
+    size_t ring_map_len;      // 持久模式下映射的文件长度，0表示记录区是堆内存
+    char *staging[2];         // 写文件暂存区，一批日志渲染后一次write；异步后端下双缓冲交替使用
+    int staging_index;        // 当前渲染使用的暂存区
 } log_buffer_t;
 
+// 基于原始系统调用的最小io_uring封装，同一时刻最多一个写请求在途，保证日志顺序
+typedef struct log_uring
+{
+    int ring_fd;
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    void *sq_ptr, *cq_ptr;
+    size_t sq_len, cq_len, sqes_len;
+    bool inflight;           // 是否有写请求在途
+    int inflight_fd;         // 在途请求的文件
+    const char *inflight_buf; // 在途请求的数据
+    size_t inflight_len;     // 在途请求的长度
+} log_uring_t;
+
+// 映射输出：只映射文件尾部一个固定大小的窗口，写满后解除映射并映射下一个窗口
+typedef struct log_mmap
+{
+    int fd;
+    off_t file_len;     // 已预分配的文件长度
+    off_t data_len;     // 实际写入的日志长度
+    char *window;       // 当前映射窗口
+    off_t window_off;   // 窗口在文件中的偏移(页对齐)
+    size_t growth_step; // 每次预分配的长度
+} log_mmap_t;
+
+// 日志分段：当前段将超过上限时改名为<路径>.1，旧段依次后移，超出保留数的最旧段被覆盖
+// 下一段<路径>.next提前创建并预分配，轮转时改名即可；仅写线程访问，生产者只写环形缓冲区不受影响
+typedef struct log_rotation
+{
+    size_t max_bytes; // 每段上限，0表示不分段
+    int retained;     // 保留的旧段数
+    int fd;           // 写线程日志文件的描述符，新段dup2到同一描述符上，FILE*无需重新打开
+    off_t bytes;      // 当前段已写出的字节数(映射模式下以映射的data_len为准)
+} log_rotation_t;
+
+// 压缩状态，仅写线程访问
+typedef struct log_compress
+{
+    bool enabled;
+    bool stream_started; // 当前文件是否已写出流头
+    unsigned char *hist; // [最近LOG_LZ_WINDOW字节的历史 | 本帧原文]
+    size_t hist_len;     // hist中的有效字节数
+    uint32_t hist_pos;   // hist[0]在流中的位置(按2^32回绕)
+    uint32_t *hash;      // 4字节前缀哈希 -> 最近一次出现的流位置
+    char *out[2];        // 压缩结果，与两个暂存区一一对应
+    uint64_t raw_bytes;  // 累计原文字节数
+    uint64_t out_bytes;  // 累计写出字节数
+} log_compress_t;
+
 // 日志缓冲区
-static log_buffer_t g_log_buffer = {.entries = NULL, .capacity = 0, .count = 0, .read_index = 0, .write_index = 0};
+static log_ring_header_t g_log_ring_local = {.read_index = 0, .write_index = 0};
+static log_buffer_t g_log_buffer = {.arena = NULL, .capacity = 0, .ring = &g_log_ring_local, .ring_map_len = 0, .staging = {NULL, NULL}, .staging_index = 0};
+// 持久环形缓冲区文件路径，为空时记录区在堆上
+static char g_log_ring_file_path[MAX_LOG_FILE_PATH_LEN] = "";
+
+// 写文件后端，init时探测，io_uring不可用时回退同步write
+static int g_log_backend = LOG_BACKEND_SYNC;
+static log_uring_t g_log_uring = {.ring_fd = -1};
+static log_mmap_t g_log_mmap = {.fd = -1, .window = NULL, .growth_step = DEFAULT_LOG_MMAP_GROWTH_STEP};
+static log_rotation_t g_log_rotation = {.max_bytes = 0, .retained = DEFAULT_LOG_RETAINED_SEGMENTS, .fd = -1, .bytes = 0};
+static log_compress_t g_log_compress = {.enabled = false, .stream_started = false, .hist = NULL, .hash = NULL, .out = {NULL, NULL}};
 
 // 模块链表头尾指针
 static module_info_t *g_module_list_head = NULL;
 static module_info_t *g_module_list_tail = NULL;
+static int g_module_count = 0;
+
+// 槽数组与槽数一起发布，无锁查找不会读到不匹配的组合
+typedef struct module_slots
+{
+    size_t size;                  // 槽数，2的幂
+    struct module_slots *retired; // 扩容前的槽数组，无锁查找可能仍在读，释放资源时才回收
+    module_info_t *_Atomic slot[];
+} module_slots_t;
+
+// 按模块名索引的开放寻址(线性探测)哈希表，链表仍保留用于按出现顺序输出
+// 插入和扩容须持有g_module_list_mutex；模块项初始化完成后才以release写入槽，查找不加锁
+typedef struct module_table
+{
+    module_slots_t *_Atomic slots;
+    size_t used; // 已用槽数
+} module_table_t;
+
+static module_table_t g_module_table = {.slots = NULL, .used = 0};
+// 按模块句柄直接索引模块信息
+static module_info_t *g_module_by_id[MAX_MODULE_NUM];
 
 // 日志文件路径
 static char g_log_file_path[MAX_LOG_FILE_PATH_LEN];
 // 日志刷新阈值
 static int g_log_flush_threshold = DEFAULT_LOG_FLUSH_THRESHOLD;
+// 模块耗时的输出精度
+static int g_log_time_precision = LOG_TIME_PRECISION_S;
+// init时同时读取的墙上时间和单调时钟，用于把模块首末打印时间换算为日期
+static int64_t g_log_wall_anchor_ns = 0;
+static int64_t g_log_mono_anchor_ns = 0;
 
 // 日志写入线程
 static pthread_t g_writer_thread;
-static bool g_writer_thread_running = false;
-// log_buffer写入互斥锁
+static atomic_bool g_writer_thread_running = false;
+// 写线程门铃(eventfd)及状态
+static int g_writer_doorbell_fd = -1;
+static atomic_int g_writer_state = WRITER_BUSY;
+// 未满阈值的日志在缓冲区中最多停留的时间
+static int g_log_flush_idle_ms = DEFAULT_LOG_FLUSH_IDLE_MS;
+// 消费环形缓冲区中记录的互斥锁，由写文件的调用方和覆盖策略下丢弃最旧记录的生产者持有，不覆盖文件I/O
 static pthread_mutex_t g_log_buf_mutex = PTHREAD_MUTEX_INITIALIZER;
+// 串行化写文件的调用方(写线程/单元测试)，覆盖渲染和文件I/O的全过程
+static pthread_mutex_t g_log_write_mutex = PTHREAD_MUTEX_INITIALIZER;
+// 模块链表互斥锁
+static pthread_mutex_t g_module_list_mutex = PTHREAD_MUTEX_INITIALIZER;
 
-int get_seconds_from_first_log(const char *module_name)
+// 缓冲区满时的处理策略及溢出计数
+static int g_log_overflow_policy = LOG_OVERFLOW_DROP_NEWEST;
+static int g_log_block_timeout_ms = DEFAULT_LOG_BLOCK_TIMEOUT_MS;
+static atomic_size_t g_log_overflow_total = 0;
+static size_t g_log_overflow_reported = 0; // 仅写线程访问
+static module_info_t *g_log_overflow_module = NULL; // 汇总记录所属的内部模块，首次溢出时登记
+// 阻塞策略下等待空间的生产者，写线程归还空间后广播；条件变量在init_log_buffer中改用单调时钟
+static pthread_mutex_t g_log_space_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_log_space_cond = PTHREAD_COND_INITIALIZER;
+static atomic_int g_log_space_waiters = 0;
+// 溢写文件，生产者之间用锁串行
+static pthread_mutex_t g_log_spill_mutex = PTHREAD_MUTEX_INITIALIZER;
+static int g_log_spill_fd = -1;
+
+// FNV-1a哈希，最多取前max_len个字符
+static uint32_t fnv1a_hash(const char *str, size_t max_len)
 {
-    module_info_t *p = g_module_list_head;
-    while (p != NULL)
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < max_len && str[i] != '\0'; i++)
     {
-        if (strcmp(p->module_name, module_name) == 0)
+        h = (h ^ (unsigned char)str[i]) * 16777619u;
+    }
+    return h;
+}
+
+// 只取模块名实际保存的前MAX_MODULE_NAME_LEN-1个字符
+static uint32_t module_name_hash(const char *module_name)
+{
+    return fnv1a_hash(module_name, MAX_MODULE_NAME_LEN - 1);
+}
+
+static module_info_t *_Atomic *module_table_probe(module_slots_t *slots, uint32_t hash, const char *module_name)
+{
+    size_t i = hash & (slots->size - 1);
+    module_info_t *m;
+    while ((m = atomic_load_explicit(&slots->slot[i], memory_order_acquire)) != NULL &&
+           (m->hash != hash || strncmp(m->module_name, module_name, MAX_MODULE_NAME_LEN - 1) != 0))
+    {
+        i = (i + 1) & (slots->size - 1);
+    }
+    return &slots->slot[i];
+}
+
+// 不加锁查找；与插入并发时可能找不到刚登记的模块，调用方加锁后再查一次
+static module_info_t *find_module_info(const char *module_name, uint32_t hash)
+{
+    module_slots_t *slots = atomic_load_explicit(&g_module_table.slots, memory_order_acquire);
+    if (slots == NULL)
+    {
+        return NULL;
+    }
+    return atomic_load_explicit(module_table_probe(slots, hash, module_name), memory_order_acquire);
+}
+
+// 为插入一个模块预留空间，负载将超过3/4时容量翻倍并重新散列，须持有g_module_list_mutex
+static int module_table_reserve()
+{
+    module_slots_t *slots = atomic_load_explicit(&g_module_table.slots, memory_order_relaxed);
+    size_t size = slots == NULL ? 0 : slots->size;
+    if ((g_module_table.used + 1) * 4 > size * 3)
+    {
+        size_t new_size = size == 0 ? MODULE_TABLE_INIT_SIZE : size * 2;
+        module_slots_t *new_slots = calloc(1, sizeof(module_slots_t) + new_size * sizeof(module_info_t *));
+        if (new_slots == NULL)
         {
-            return difftime(p->last_log_time, p->first_log_time);
+            return -1;
         }
-        p = p->next;
+        new_slots->size = new_size;
+        new_slots->retired = slots;
+        for (size_t i = 0; i < size; i++)
+        {
+            module_info_t *old = atomic_load_explicit(&slots->slot[i], memory_order_relaxed);
+            if (old != NULL)
+            {
+                atomic_store_explicit(module_table_probe(new_slots, old->hash, old->module_name), old,
+                                      memory_order_relaxed);
+            }
+        }
+        atomic_store_explicit(&g_module_table.slots, new_slots, memory_order_release);
+    }
+    return 0;
+}
+
+// 发布已初始化完成的模块项，须先调用module_table_reserve
+static void module_table_insert(module_info_t *m)
+{
+    module_slots_t *slots = atomic_load_explicit(&g_module_table.slots, memory_order_relaxed);
+    atomic_store_explicit(module_table_probe(slots, m->hash, m->module_name), m, memory_order_release);
+    g_module_table.used++;
+}
+
+int get_seconds_from_first_log(const char *module_name)
+{
+    module_info_t *p = find_module_info(module_name, module_name_hash(module_name));
+    if (p != NULL)
+    {
+        return (p->last_log_ns - p->first_log_ns) / 1000000000;
     }
 
     return 0;
 }
 
+module_info_t *add_module_info(const char *module_name, const char *dependencies);
+
+// 将逗号分隔的依赖模块名逐个转换为模块id并加入集合，未出现过的模块名先登记
+static void merge_module_dependencies(module_info_t *m, const char *dependencies)
+{
+    char name[MAX_MODULE_NAME_LEN];
+    const char *p = dependencies;
+    while (p != NULL && *p != '\0')
+    {
+        const char *end = strchrnul(p, ',');
+        size_t len = end - p;
+        if (len > 0 && len < MAX_MODULE_NAME_LEN)
+        {
+            memcpy(name, p, len);
+            name[len] = '\0';
+            module_info_t *d = find_module_info(name, module_name_hash(name));
+            if (d == NULL)
+            {
+                d = add_module_info(name, NULL);
+            }
+            if (d != NULL)
+            {
+                m->dependencies[d->id / 64] |= 1ull << (d->id % 64);
+            }
+        }
+        p = *end == '\0' ? end : end + 1;
+    }
+}
+
+// 在持久环形缓冲区的模块名区追加一项，须持有g_module_list_mutex；未启用或空间不足时返回NULL
+static log_ring_module_t *add_log_ring_module(const module_info_t *m)
+{
+    log_ring_header_t *ring = g_log_buffer.ring;
+    if (g_log_buffer.ring_map_len == 0)
+    {
+        return NULL;
+    }
+    size_t name_len = strlen(m->module_name);
+    size_t size = (offsetof(log_ring_module_t, name) + name_len + 7) & ~(size_t)7;
+    uint64_t used = atomic_load_explicit(&ring->module_area_used, memory_order_relaxed);
+    if (used + size > ring->module_area_len)
+    {
+        return NULL;
+    }
+    log_ring_module_t *rm = (log_ring_module_t *)((char *)ring + ring->module_area_off + used);
+    atomic_init(&rm->first_log_ns, 0);
+    rm->id = m->id;
+    rm->name_len = name_len;
+    memcpy(rm->name, m->module_name, name_len);
+    atomic_store_explicit(&ring->module_area_used, used + size, memory_order_release);
+    return rm;
+}
+
 module_info_t *add_module_info(const char *module_name, const char *dependencies)
 {
+    if (g_module_count >= MAX_MODULE_NUM)
+    {
+        fprintf(stderr, "Too many modules.\n");
+        return NULL;
+    }
+    if (module_table_reserve() != 0)
+    {
+        fprintf(stderr, "Failed to allocate memory for module table.\n");
+        return NULL;
+    }
     module_info_t *m = malloc(sizeof(module_info_t));
     if (m == NULL)
     {
         fprintf(stderr, "Failed to allocate memory for module info.\n");
         return NULL;
     }
-    strncpy(m->module_name, module_name, MAX_MODULE_NAME_LEN);
-    m->first_log_time = 0;
-    m->last_log_time = 0;
-    strcpy(m->dependencies, dependencies);
+    snprintf(m->module_name, MAX_MODULE_NAME_LEN, "%s", module_name);
+    m->hash = module_name_hash(m->module_name);
+    atomic_init(&m->deps_hash, 0);
+    m->id = g_module_count;
+    m->announced = false;
+    m->first_log_ns = 0;
+    m->last_log_ns = 0;
+    memset(m->dependencies, 0, sizeof(m->dependencies));
+    atomic_init(&m->overflow_count, 0);
+    m->overflow_reported = 0;
     m->next = NULL;
+    m->ring_module = add_log_ring_module(m);
+    // 各字段初始化完成后再插入哈希表，无锁查找到的模块项总是完整的
+    g_module_by_id[m->id] = m;
+    g_module_count++;
+    module_table_insert(m);
     if (g_module_list_head == NULL)
     {
         g_module_list_head = m;
@@ -95,264 +473,2162 @@ module_info_t *add_module_info(const char *module_name, const char *dependencies
         g_module_list_tail->next = m;
     }
     g_module_list_tail = m;
+    merge_module_dependencies(m, dependencies);
     return m;
 }
 
+// 依赖串的哈希，0留作"尚未合并"
+static uint32_t dependencies_hash(const char *dependencies)
+{
+    uint32_t h = fnv1a_hash(dependencies, SIZE_MAX);
+    return h == 0 ? 1 : h;
+}
+
+// 模块已合并过相同的依赖串(或本次没有依赖)时不必再加锁合并；哈希相同即视为相同
+static bool module_dependencies_merged(module_info_t *m, const char *dependencies)
+{
+    return dependencies == NULL || dependencies[0] == '\0' ||
+           atomic_load_explicit(&m->deps_hash, memory_order_relaxed) == dependencies_hash(dependencies);
+}
+
+// 须持有g_module_list_mutex
 module_info_t *find_or_add_module_info(const char *module_name, const char *dependencies)
 {
-    module_info_t *p = g_module_list_head;
-    while (p != NULL)
+    module_info_t *p = find_module_info(module_name, module_name_hash(module_name));
+    if (p == NULL)
     {
-        if (strcmp(p->module_name, module_name) == 0)
+        p = add_module_info(module_name, dependencies);
+    }
+    else
+    {
+        merge_module_dependencies(p, dependencies);
+    }
+    if (p != NULL && dependencies != NULL && dependencies[0] != '\0')
+    {
+        atomic_store_explicit(&p->deps_hash, dependencies_hash(dependencies), memory_order_relaxed);
+    }
+    return p;
+}
+
+// 写文件时发起的系统调用次数(write及io_uring_enter)
+static atomic_ulong g_log_write_syscalls = 0;
+
+// 写满len字节，处理被信号打断和部分写入
+static int write_all(int fd, const char *buf, size_t len)
+{
+    while (len > 0)
+    {
+        ssize_t n = write(fd, buf, len);
+        atomic_fetch_add_explicit(&g_log_write_syscalls, 1, memory_order_relaxed);
+        if (n < 0)
         {
-            if (dependencies != NULL && strlen(dependencies) > 0)
+            if (errno == EINTR)
             {
-                // 先判断当前字符串是不是空的，如果为空则不需要输入逗号
-                if (strlen(p->dependencies) > 0)
-                {
-                    strncat(p->dependencies, ",", MAX_DEPENDENCIES_LEN - strlen(p->dependencies) - 1);
-                }
-                char *tmp_dependencies = strdup(dependencies);
-                char *tok = strtok(tmp_dependencies, ",");
-                while (tok != NULL)
-                {
-                    if (strstr(p->dependencies, tok) == NULL)
-                    {
-                        strncat(p->dependencies, tok, MAX_DEPENDENCIES_LEN - strlen(p->dependencies) - 1);
-                    }
-                    tok = strtok(NULL, ",");
-                }
-                free(tmp_dependencies);
+                continue;
             }
-            return p;
+            return -1;
         }
-        p = p->next;
+        buf += n;
+        len -= n;
     }
-    return add_module_info(module_name, dependencies);
+    return 0;
 }
 
-int init_log_buffer(int capacity, const char *log_path, int flush_threshold)
+static int log_uring_init(log_uring_t *u)
 {
-    // init log file path
-    if (NULL != log_path)
-    {
-        snprintf(g_log_file_path, MAX_LOG_FILE_PATH_LEN, "%s", log_path);
-    }
-    else
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    u->ring_fd = syscall(__NR_io_uring_setup, LOG_URING_ENTRIES, &p);
+    if (u->ring_fd < 0)
     {
-        snprintf(g_log_file_path, MAX_LOG_FILE_PATH_LEN, "%s", DEFAULT_LOG_FILE_PATH);
+        return -1;
     }
-    // init log flush threshold
-    g_log_flush_threshold = flush_threshold <= 0 ? DEFAULT_LOG_FLUSH_THRESHOLD : flush_threshold;
-
-    // init log buffer
-    g_log_buffer.entries = (log_entry_t *)malloc(capacity * sizeof(log_entry_t));
-    if (g_log_buffer.entries == NULL)
+    u->sq_len = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    u->cq_len = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    u->sqes_len = p.sq_entries * sizeof(struct io_uring_sqe);
+    u->sq_ptr = mmap(NULL, u->sq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->ring_fd, IORING_OFF_SQ_RING);
+    u->cq_ptr = mmap(NULL, u->cq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->ring_fd, IORING_OFF_CQ_RING);
+    u->sqes = mmap(NULL, u->sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->ring_fd, IORING_OFF_SQES);
+    if (u->sq_ptr == MAP_FAILED || u->cq_ptr == MAP_FAILED || u->sqes == MAP_FAILED)
     {
-        fprintf(stderr, "Failed to allocate memory for log buffer.\n");
+        // 任一映射失败均按不可用处理，已成功的映射随进程退出回收
+        close(u->ring_fd);
+        u->ring_fd = -1;
         return -1;
     }
-    memset(g_log_buffer.entries, 0, capacity * sizeof(log_entry_t));
-    g_log_buffer.capacity = capacity <= 0 ? DEFAULT_LOG_ENTRIES_CAPACITY : capacity;
-    g_log_buffer.count = 0;
-    g_log_buffer.read_index = 0;
-    g_log_buffer.write_index = 0;
-
+    u->sq_head = (unsigned *)((char *)u->sq_ptr + p.sq_off.head);
+    u->sq_tail = (unsigned *)((char *)u->sq_ptr + p.sq_off.tail);
+    u->sq_mask = (unsigned *)((char *)u->sq_ptr + p.sq_off.ring_mask);
+    u->sq_array = (unsigned *)((char *)u->sq_ptr + p.sq_off.array);
+    u->cq_head = (unsigned *)((char *)u->cq_ptr + p.cq_off.head);
+    u->cq_tail = (unsigned *)((char *)u->cq_ptr + p.cq_off.tail);
+    u->cq_mask = (unsigned *)((char *)u->cq_ptr + p.cq_off.ring_mask);
+    u->cqes = (struct io_uring_cqe *)((char *)u->cq_ptr + p.cq_off.cqes);
+    u->inflight = false;
     return 0;
 }
 
-void print_to_log_buffer(const char *module_name, const char *dependencies, const char *log_content)
+static void log_uring_exit(log_uring_t *u)
 {
-    // check param
-    if(module_name == NULL || log_content == NULL)
+    if (u->ring_fd < 0)
     {
         return;
     }
-    
-    // get current time
-    time_t current_time = time(NULL);
+    munmap(u->sqes, u->sqes_len);
+    munmap(u->cq_ptr, u->cq_len);
+    munmap(u->sq_ptr, u->sq_len);
+    close(u->ring_fd);
+    u->ring_fd = -1;
+}
 
-    // calculate seconds from first log
-    int seconds = 0;
-    if (g_module_list_head != NULL)
+// 提交一个追加写请求，不等待完成
+// 返回0时请求已被内核取走；返回-1时请求已从提交队列撤回，调用方可以同步写同一缓冲区
+static int log_uring_submit_write(log_uring_t *u, int fd, const char *buf, size_t len)
+{
+    unsigned tail = *u->sq_tail;
+    unsigned index = tail & *u->sq_mask;
+    struct io_uring_sqe *sqe = &u->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = IORING_OP_WRITE;
+    sqe->fd = fd;
+    sqe->off = (__u64)-1; // 使用文件当前位置，日志文件以追加方式打开
+    sqe->addr = (unsigned long)buf;
+    sqe->len = len;
+    u->sq_array[index] = index;
+    __atomic_store_n(u->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    // 以内核的sq_head越过该请求为准，io_uring_enter被打断或暂时无资源时重试
+    int retries = 0;
+    while (1)
     {
-        module_info_t *m = find_or_add_module_info(module_name, dependencies);
-        if (m == NULL)
+        atomic_fetch_add_explicit(&g_log_write_syscalls, 1, memory_order_relaxed);
+        long ret = syscall(__NR_io_uring_enter, u->ring_fd, 1, 0, 0, NULL, 0);
+        if (__atomic_load_n(u->sq_head, __ATOMIC_ACQUIRE) != tail)
         {
-            fprintf(stderr, "Failed to add module info.\n");
-            return;
+            break;
         }
-
-        if (m->first_log_time == 0)
+        if (ret < 0 && errno == EINTR)
         {
-            m->first_log_time = current_time;
-            seconds = 0;
+            continue;
         }
-        else
+        if ((ret >= 0 || errno == EAGAIN || errno == EBUSY) && ++retries < LOG_URING_SUBMIT_RETRIES)
         {
-            seconds = get_seconds_from_first_log(module_name);
+            continue;
         }
-        m->last_log_time = current_time;
+        // 未使用SQPOLL，内核只在io_uring_enter中读取提交队列，撤回尚未取走的请求后，
+        // 调用方同步写入不会与之后某次io_uring_enter重复提交的旧请求冲突
+        __atomic_store_n(u->sq_tail, tail, __ATOMIC_RELEASE);
+        return -1;
     }
+    u->inflight = true;
+    u->inflight_fd = fd;
+    u->inflight_buf = buf;
+    u->inflight_len = len;
+    return 0;
+}
 
-    if (g_log_buffer.count < g_log_buffer.capacity)
+// 等待在途写请求完成，部分写入的剩余内容同步补写
+static int log_uring_wait(log_uring_t *u)
+{
+    if (!u->inflight)
     {
-        g_log_buffer.entries[g_log_buffer.write_index].seconds_from_first_log = seconds;
-        strftime(g_log_buffer.entries[g_log_buffer.write_index].timestr, 20, "%Y-%m-%d %H:%M:%S", localtime(&current_time));
-
-        strncpy(g_log_buffer.entries[g_log_buffer.write_index].log_content, log_content, MAX_LOG_ENTRY_LEN);
-
-        g_log_buffer.write_index = (g_log_buffer.write_index + 1) % g_log_buffer.capacity;
-        if (g_log_buffer.count < g_log_buffer.capacity)
-        {
-            pthread_mutex_lock(&g_log_buf_mutex);
-            g_log_buffer.count++;
-            pthread_mutex_unlock(&g_log_buf_mutex);
-        }
-        else
+        return 0;
+    }
+    unsigned head = *u->cq_head;
+    while (head == __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE))
+    {
+        atomic_fetch_add_explicit(&g_log_write_syscalls, 1, memory_order_relaxed);
+        if (syscall(__NR_io_uring_enter, u->ring_fd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0) < 0 && errno != EINTR)
         {
-            g_log_buffer.read_index = (g_log_buffer.read_index + 1) % g_log_buffer.capacity;
+            return -1;
         }
     }
-    else
+    int res = u->cqes[head & *u->cq_mask].res;
+    __atomic_store_n(u->cq_head, head + 1, __ATOMIC_RELEASE);
+    u->inflight = false;
+    if (res < 0)
+    {
+        return -1;
+    }
+    if ((size_t)res < u->inflight_len)
     {
-        fprintf(stderr, "Log buffer is full!\n");
+        return write_all(u->inflight_fd, u->inflight_buf + res, u->inflight_len - res);
     }
-    return;
+    return 0;
 }
 
-// 将writer_thread_func中写文件的部分抽出来，方便单元测试
-int write_log_content_to_file(FILE *file)
+// 保证文件已预分配到end，按growth_step整块扩展
+static int log_mmap_grow(log_mmap_t *m, off_t end)
 {
-    int count = 0;
-    int index = 0;
-    if (file == NULL)
+    if (end <= m->file_len)
+    {
+        return 0;
+    }
+    off_t new_len = m->file_len;
+    while (new_len < end)
+    {
+        new_len += m->growth_step;
+    }
+    // 不支持fallocate的文件系统退化为ftruncate，保证映射区不越过文件尾
+    if (fallocate(m->fd, 0, m->file_len, new_len - m->file_len) != 0 && ftruncate(m->fd, new_len) != 0)
     {
         return -1;
     }
+    m->file_len = new_len;
+    return 0;
+}
 
-    // 仅对count和read_index加锁互斥写入
-    pthread_mutex_lock(&g_log_buf_mutex);
-    count = g_log_buffer.count;
-    index = g_log_buffer.read_index;
-    pthread_mutex_unlock(&g_log_buf_mutex);
-
-    for (int i = 0; i < count; i++)
+// 映射包含data_len的窗口
+static int log_mmap_map_window(log_mmap_t *m)
+{
+    if (m->window != NULL)
     {
-        fprintf(file, "[%s][%s][%d]%s\n",
-                g_log_buffer.entries[index].timestr,
-                g_log_buffer.entries[index].module_name,
-                g_log_buffer.entries[index].seconds_from_first_log,
-                g_log_buffer.entries[index].log_content);
-
-        index = (index + 1) % g_log_buffer.capacity;
+        munmap(m->window, LOG_MMAP_WINDOW_LEN);
+        m->window = NULL;
     }
-    fflush(file);
-
-    pthread_mutex_lock(&g_log_buf_mutex);
-    g_log_buffer.count -= count;
-    g_log_buffer.read_index = index;
-    pthread_mutex_unlock(&g_log_buf_mutex);
-
+    m->window_off = m->data_len & ~((off_t)sysconf(_SC_PAGESIZE) - 1);
+    if (log_mmap_grow(m, m->window_off + LOG_MMAP_WINDOW_LEN) != 0)
+    {
+        return -1;
+    }
+    char *w = mmap(NULL, LOG_MMAP_WINDOW_LEN, PROT_READ | PROT_WRITE, MAP_SHARED, m->fd, m->window_off);
+    if (w == MAP_FAILED)
+    {
+        return -1;
+    }
+    m->window = w;
     return 0;
 }
 
-
-int ouput_log_module_list(FILE *log_file)
+// 打开日志文件并从已有内容之后开始映射
+static int log_mmap_open(log_mmap_t *m, const char *path)
 {
-    module_info_t *p = NULL;
-    if (log_file == NULL)
+    m->fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (m->fd < 0)
     {
         return -1;
     }
-    fprintf(log_file, "[%s][%s][%s][%s]%s\n", "module", "first_log_time", "last_log_time", "diff", "dependencies");
-    p = g_module_list_head;
-    while (p != NULL)
+    m->data_len = lseek(m->fd, 0, SEEK_END);
+    m->file_len = m->data_len;
+    m->window = NULL;
+    if (log_mmap_map_window(m) != 0)
     {
-        double diff = difftime(p->last_log_time, p->first_log_time);
-        fprintf(log_file, "[%s][%s][%s][%.2lf]%s\n",
-                p->module_name,
-                asctime(localtime(&p->first_log_time)),
-                asctime(localtime(&p->last_log_time)),
-                diff,
-                p->dependencies);
-        p = p->next;
+        close(m->fd);
+        m->fd = -1;
+        return -1;
     }
-
     return 0;
 }
 
-void *writer_thread_func(void *arg)
+// 返回可写入len字节的位置，窗口剩余空间不足时滑动窗口
+static char *log_mmap_reserve(log_mmap_t *m, size_t len)
 {
-    FILE *log_file = NULL;
-
-    log_file = fopen(g_log_file_path, "a");
-    if (log_file == NULL)
+    if (m->data_len + (off_t)len > m->window_off + LOG_MMAP_WINDOW_LEN && log_mmap_map_window(m) != 0)
     {
-        fprintf(stderr, "Failed to open log file: %s\n", g_log_file_path);
         return NULL;
     }
+    return m->window + (m->data_len - m->window_off);
+}
 
-    while (1)
+// 解除映射并截断预分配的多余部分
+static void log_mmap_close(log_mmap_t *m)
+{
+    if (m->fd < 0)
     {
-        sleep(1);
-
-        if (g_log_buffer.count >= g_log_flush_threshold)
-        {
-            write_log_content_to_file(log_file);
-        }
-
-        if (!g_writer_thread_running)
-        {
-            write_log_content_to_file(log_file);
-            break;
-        }
+        return;
     }
-
-    ouput_log_module_list(log_file);
-
-    fclose(log_file);
-
-    return NULL;
+    if (m->window != NULL)
+    {
+        munmap(m->window, LOG_MMAP_WINDOW_LEN);
+        m->window = NULL;
+    }
+    if (ftruncate(m->fd, m->data_len) != 0)
+    {
+        fprintf(stderr, "Failed to truncate log file.\n");
+    }
+    close(m->fd);
+    m->fd = -1;
 }
 
-// stop thread
-void stop_log_writer_thread()
+// 选择写文件后端，须在init之后、启动写线程之前调用；不可用时回退同步write
+int set_log_backend(int backend)
 {
-    g_writer_thread_running = false;
-    pthread_join(g_writer_thread, NULL);
+    if (backend == LOG_BACKEND_IO_URING && g_log_uring.ring_fd < 0)
+    {
+        backend = LOG_BACKEND_SYNC;
+    }
+    g_log_backend = backend;
+    return g_log_backend;
 }
 
-int start_log_writer_thread()
+// 设置映射模式下每次预分配的长度
+void set_log_mmap_growth_step(size_t growth_step)
 {
-    return pthread_create(&g_writer_thread, NULL, writer_thread_func, NULL);
+    g_log_mmap.growth_step = growth_step == 0 ? DEFAULT_LOG_MMAP_GROWTH_STEP : growth_step;
 }
 
-void release_log_resources()
+// 按段上限和保留的旧段数分段输出，max_bytes为0时不分段；须在启动写线程之前调用
+int set_log_rotation(size_t max_bytes, int retained_segments)
 {
-    stop_log_writer_thread();
-    pthread_mutex_destroy(&g_log_buf_mutex);
-
-    if (g_log_buffer.entries != NULL)
+    if (retained_segments < 0)
     {
-        free(g_log_buffer.entries);
+        return -1;
     }
-    module_info_t *p = g_module_list_head;
-    while (p != NULL)
+    g_log_rotation.max_bytes = max_bytes;
+    g_log_rotation.retained = retained_segments;
+    return 0;
+}
+
+// 开启或关闭写文件前的压缩，须在启动写线程之前调用，内存不足时返回-1
+// 映射后端直接渲染进文件，不经过暂存区，开启压缩时写线程改用同步write
+int set_log_compression(bool enabled)
+{
+    log_compress_t *c = &g_log_compress;
+    if (enabled && c->hist == NULL)
     {
-        module_info_t *tmp = p;
-        p = p->next;
-        free(tmp);
+        c->hist = malloc(LOG_LZ_WINDOW + LOG_STAGING_BUF_LEN);
+        c->hash = calloc(1 << LOG_LZ_HASH_BITS, sizeof(uint32_t));
+        c->out[0] = malloc(LOG_LZ_MAX_FRAME_LEN(LOG_STAGING_BUF_LEN) * 2);
+        if (c->hist == NULL || c->hash == NULL || c->out[0] == NULL)
+        {
+            free(c->hist);
+            free(c->hash);
+            free(c->out[0]);
+            c->hist = NULL;
+            c->hash = NULL;
+            c->out[0] = NULL;
+            return -1;
+        }
+        c->out[1] = c->out[0] + LOG_LZ_MAX_FRAME_LEN(LOG_STAGING_BUF_LEN);
     }
+    c->enabled = enabled;
+    return 0;
 }
 
-int main()
+// 选择缓冲区满时的处理策略，须在启动写线程之前调用；block_timeout_ms仅对阻塞策略有效
+int set_log_overflow_policy(int policy, int block_timeout_ms)
 {
-    if (init_log_buffer(DEFAULT_LOG_ENTRIES_CAPACITY, DEFAULT_LOG_FILE_PATH, DEFAULT_LOG_FLUSH_THRESHOLD) != 0)
+    if (policy < LOG_OVERFLOW_DROP_NEWEST || policy > LOG_OVERFLOW_SPILL)
     {
-        fprintf(stderr, "Failed to initialize log buffer.\n");
-        exit(EXIT_FAILURE);
+        return -1;
     }
+    g_log_overflow_policy = policy;
+    g_log_block_timeout_ms = block_timeout_ms <= 0 ? DEFAULT_LOG_BLOCK_TIMEOUT_MS : block_timeout_ms;
+    return 0;
+}
+
+// 设置模块耗时的输出精度(LOG_TIME_PRECISION_S/MS/US)，须在启动写线程之前调用
+int set_log_time_precision(int precision)
+{
+    if (precision != LOG_TIME_PRECISION_S && precision != LOG_TIME_PRECISION_MS && precision != LOG_TIME_PRECISION_US)
+    {
+        return -1;
+    }
+    g_log_time_precision = precision;
+    return 0;
+}
+
+// 读取单调时钟纳秒，模块耗时不受启动过程中NTP调整墙上时间的影响
+static int64_t log_mono_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// 按init时的对应关系把单调时钟换算为墙上时间
+static time_t log_mono_to_wall(int64_t mono_ns)
+{
+    return (g_log_wall_anchor_ns + (mono_ns - g_log_mono_anchor_ns)) / 1000000000;
+}
+
+// 按输出精度格式化一段纳秒时长，返回写入的长度
+static size_t format_log_elapsed(char *dst, int64_t ns)
+{
+    char digits[24];
+    int n = 0;
+    char *p = dst;
+    uint64_t v = ns < 0 ? -(uint64_t)ns : (uint64_t)ns;
+    // 按精度截断，再从低位起逐位输出，小数位不足时补0
+    for (int i = g_log_time_precision; i < 9; i++)
+    {
+        v /= 10;
+    }
+    if (ns < 0)
+    {
+        *p++ = '-';
+    }
+    do
+    {
+        digits[n++] = '0' + v % 10;
+        v /= 10;
+    } while (v > 0 || n <= g_log_time_precision);
+    while (n > 0)
+    {
+        *p++ = digits[--n];
+        if (n == g_log_time_precision && n > 0)
+        {
+            *p++ = '.';
+        }
+    }
+    return p - dst;
+}
+
+// 返回init时选定的写文件后端
+int get_log_backend()
+{
+    return g_log_backend;
+}
+
+const char *get_log_backend_name()
+{
+    static const char *names[] = {"sync", "io_uring", "mmap"};
+    return names[g_log_backend];
+}
+
+// 设置持久环形缓冲区文件路径(建议放在/dev/shm等tmpfs下)，NULL或空串关闭，须在init之前调用
+void set_log_ring_file(const char *ring_path)
+{
+    snprintf(g_log_ring_file_path, MAX_LOG_FILE_PATH_LEN, "%s", ring_path != NULL ? ring_path : "");
+}
+
+// 上次使用的环形缓冲区文件没有正常释放时改名为<路径>.crashed保留，供bootlog-recover取出记录
+static void keep_crashed_log_ring(const char *path)
+{
+    log_ring_header_t hdr;
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return;
+    }
+    ssize_t n = read(fd, &hdr, sizeof(hdr));
+    close(fd);
+    if (n == sizeof(hdr) && hdr.magic == LOG_RING_MAGIC && hdr.state != LOG_RING_STATE_CLEAN)
+    {
+        char crashed_path[MAX_LOG_FILE_PATH_LEN + 8];
+        snprintf(crashed_path, sizeof(crashed_path), "%s.crashed", path);
+        if (rename(path, crashed_path) == 0)
+        {
+            fprintf(stderr, "Previous log ring was not released, kept as %s\n", crashed_path);
+        }
+    }
+}
+
+// 把记录区和读写索引放到MAP_SHARED映射的文件中，写日志不增加系统调用，进程崩溃后内容仍在文件里
+static int map_log_ring(size_t capacity)
+{
+    keep_crashed_log_ring(g_log_ring_file_path);
+    int fd = open(g_log_ring_file_path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0)
+    {
+        return -1;
+    }
+    size_t len = LOG_RING_HDR_LEN + LOG_RING_MODULE_AREA_LEN + capacity;
+    // 一次分配全部空间，tmpfs空间不足时在此失败，而不是写日志时收到SIGBUS
+    if (posix_fallocate(fd, 0, len) != 0)
+    {
+        close(fd);
+        return -1;
+    }
+    char *base = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED)
+    {
+        return -1;
+    }
+
+    log_ring_header_t *ring = (log_ring_header_t *)base;
+    ring->magic = LOG_RING_MAGIC;
+    ring->version = LOG_RING_VERSION;
+    ring->record_hdr_len = offsetof(log_entry_t, log_content);
+    ring->pid = getpid();
+    ring->capacity = capacity;
+    ring->module_area_off = LOG_RING_HDR_LEN;
+    ring->module_area_len = LOG_RING_MODULE_AREA_LEN;
+    ring->arena_off = LOG_RING_HDR_LEN + LOG_RING_MODULE_AREA_LEN;
+    atomic_init(&ring->module_area_used, 0);
+    atomic_store_explicit(&ring->state, LOG_RING_STATE_ACTIVE, memory_order_release);
+    g_log_buffer.ring = ring;
+    g_log_buffer.arena = base + ring->arena_off;
+    g_log_buffer.ring_map_len = len;
+    return 0;
+}
+
+// 释放记录区；持久模式下先标记为正常释放
+static void free_log_arena()
+{
+    if (g_log_buffer.ring_map_len > 0)
+    {
+        atomic_store_explicit(&g_log_buffer.ring->state, LOG_RING_STATE_CLEAN, memory_order_release);
+        munmap(g_log_buffer.ring, g_log_buffer.ring_map_len);
+        g_log_buffer.ring = &g_log_ring_local;
+        g_log_buffer.ring_map_len = 0;
+    }
+    else
+    {
+        free(g_log_buffer.arena);
+    }
+    g_log_buffer.arena = NULL;
+}
+
+int init_log_buffer(int capacity, const char *log_path, int flush_threshold)
+{
+    // init log file path
+    if (NULL != log_path)
+    {
+        snprintf(g_log_file_path, MAX_LOG_FILE_PATH_LEN, "%s", log_path);
+    }
+    else
+    {
+        snprintf(g_log_file_path, MAX_LOG_FILE_PATH_LEN, "%s", DEFAULT_LOG_FILE_PATH);
+    }
+    // init log flush threshold
+    g_log_flush_threshold = flush_threshold <= 0 ? DEFAULT_LOG_FLUSH_THRESHOLD : flush_threshold;
+
+    // 阻塞策略的超时按单调时钟计算，启动过程中墙上时间被调整不会让等待提前结束或延长
+    pthread_condattr_t space_cond_attr;
+    pthread_condattr_init(&space_cond_attr);
+    pthread_condattr_setclock(&space_cond_attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&g_log_space_cond, &space_cond_attr);
+    pthread_condattr_destroy(&space_cond_attr);
+
+    // 记录墙上时间和单调时钟的对应关系
+    struct timespec wall;
+    clock_gettime(CLOCK_REALTIME, &wall);
+    g_log_mono_anchor_ns = log_mono_ns();
+    g_log_wall_anchor_ns = (int64_t)wall.tv_sec * 1000000000 + wall.tv_nsec;
+
+    // init log buffer，容量按记录对齐取整，且至少容纳几条最长记录
+    size_t bytes = capacity <= 0 ? DEFAULT_LOG_BUFFER_CAPACITY : (size_t)capacity;
+    bytes = bytes < MIN_LOG_BUFFER_CAPACITY ? MIN_LOG_BUFFER_CAPACITY : bytes & ~(size_t)(LOG_RECORD_ALIGN - 1);
+    g_log_buffer.capacity = bytes;
+    if (g_log_ring_file_path[0] != '\0' && map_log_ring(bytes) != 0)
+    {
+        fprintf(stderr, "Failed to map log ring file: %s\n", g_log_ring_file_path);
+    }
+    if (g_log_buffer.arena == NULL)
+    {
+        g_log_buffer.arena = (char *)calloc(1, g_log_buffer.capacity);
+    }
+    if (g_log_buffer.arena == NULL)
+    {
+        fprintf(stderr, "Failed to allocate memory for log buffer.\n");
+        return -1;
+    }
+    atomic_init(&g_log_buffer.ring->read_index, 0);
+    atomic_init(&g_log_buffer.ring->write_index, 0);
+    g_log_buffer.staging[0] = (char *)malloc(LOG_STAGING_BUF_LEN * 2);
+    if (g_log_buffer.staging[0] == NULL)
+    {
+        fprintf(stderr, "Failed to allocate memory for log staging buffer.\n");
+        free_log_arena();
+        return -1;
+    }
+    g_log_buffer.staging[1] = g_log_buffer.staging[0] + LOG_STAGING_BUF_LEN;
+    g_log_buffer.staging_index = 0;
+
+    // init write backend
+    g_log_backend = log_uring_init(&g_log_uring) == 0 ? LOG_BACKEND_IO_URING : LOG_BACKEND_SYNC;
+
+    return 0;
+}
+
+// 读取粗粒度实时时钟，走vDSO且不经过时区锁，精度满足秒级前缀
+static time_t log_clock_now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME_COARSE, &ts);
+    return ts.tv_sec;
+}
+
+// 按秒缓存格式化后的"年-月-日 时:分:秒"，每个线程各自缓存，同一秒内只拷贝19字节
+static const char *format_log_time(time_t t)
+{
+    static __thread time_t cached_time = -1;
+    static __thread char cached_timestr[20];
+    if (t != cached_time)
+    {
+        struct tm tm_now;
+        strftime(cached_timestr, sizeof(cached_timestr), "%Y-%m-%d %H:%M:%S", localtime_r(&t, &tm_now));
+        cached_time = t;
+    }
+    return cached_timestr;
+}
+
+// 当前未写入文件的日志字节数
+size_t get_log_buffer_used()
+{
+    return atomic_load_explicit(&g_log_buffer.ring->write_index, memory_order_acquire) -
+           atomic_load_explicit(&g_log_buffer.ring->read_index, memory_order_acquire);
+}
+
+// 设置空闲超时，超时后即使未达阈值也写入文件
+void set_log_flush_idle_timeout(int idle_ms)
+{
+    g_log_flush_idle_ms = idle_ms <= 0 ? DEFAULT_LOG_FLUSH_IDLE_MS : idle_ms;
+}
+
+static void ring_writer_doorbell()
+{
+    uint64_t one = 1;
+    if (g_writer_doorbell_fd >= 0 && write(g_writer_doorbell_fd, &one, sizeof(one)) < 0)
+    {
+        fprintf(stderr, "Failed to ring writer doorbell.\n");
+    }
+}
+
+// 空缓冲区来了第一条日志，或积压达到阈值时唤醒写线程
+static void notify_log_writer()
+{
+    int state = atomic_load(&g_writer_state);
+    if (state == WRITER_BUSY)
+    {
+        return;
+    }
+    if (state == WRITER_WAIT_PARTIAL && get_log_buffer_used() < (size_t)g_log_flush_threshold)
+    {
+        return;
+    }
+    if (atomic_exchange(&g_writer_state, WRITER_BUSY) != WRITER_BUSY)
+    {
+        ring_writer_doorbell();
+    }
+}
+
+// 原子预留size字节的记录空间并标记为未提交，缓冲区满时返回NULL
+// 记录不跨越缓冲区尾部：剩余空间不足时连同尾部填充一起预留，记录从缓冲区头部开始
+static log_entry_t *reserve_log_entry(size_t size)
+{
+    size_t cur = atomic_load_explicit(&g_log_buffer.ring->write_index, memory_order_relaxed);
+    while (1)
+    {
+        size_t off = cur % g_log_buffer.capacity;
+        size_t pad = off + size > g_log_buffer.capacity ? g_log_buffer.capacity - off : 0;
+        if (cur + pad + size - atomic_load_explicit(&g_log_buffer.ring->read_index, memory_order_acquire) > g_log_buffer.capacity)
+        {
+            return NULL;
+        }
+        if (atomic_compare_exchange_weak_explicit(&g_log_buffer.ring->write_index, &cur, cur + pad + size,
+                                                  memory_order_relaxed, memory_order_relaxed))
+        {
+            if (pad > 0)
+            {
+                log_entry_t *filler = (log_entry_t *)(g_log_buffer.arena + off);
+                atomic_store_explicit(&filler->size, pad | LOG_RECORD_PAD, memory_order_release);
+                off = 0;
+            }
+            log_entry_t *e = (log_entry_t *)(g_log_buffer.arena + off);
+            atomic_store_explicit(&e->size, size | LOG_RECORD_BUSY, memory_order_relaxed);
+            return e;
+        }
+    }
+}
+
+// 注册模块并返回模块句柄，之后可用print_to_log_buffer_by_handle按句柄打印；失败返回-1
+int bootlog_register_module(const char *module_name, const char *dependencies)
+{
+    if (module_name == NULL)
+    {
+        return -1;
+    }
+    pthread_mutex_lock(&g_module_list_mutex);
+    module_info_t *m = find_or_add_module_info(module_name, dependencies);
+    pthread_mutex_unlock(&g_module_list_mutex);
+    return m == NULL ? -1 : m->id;
+}
+
+// 多个线程同时打印时取最小值作为第一句的时间，渲染时算出的耗时不会为负
+static void update_first_log_ns(_Atomic int64_t *first_log_ns, int64_t now_ns)
+{
+    int64_t first = atomic_load(first_log_ns);
+    while ((first == 0 || now_ns < first) && !atomic_compare_exchange_weak(first_log_ns, &first, now_ns))
+    {
+    }
+}
+
+// 更新模块首末打印时间(单调时钟纳秒)
+static void touch_module_info(module_info_t *m, int64_t now_ns)
+{
+    update_first_log_ns(&m->first_log_ns, now_ns);
+    if (m->ring_module != NULL)
+    {
+        update_first_log_ns(&m->ring_module->first_log_ns, now_ns);
+    }
+    int64_t last = atomic_load(&m->last_log_ns);
+    while (last < now_ns && !atomic_compare_exchange_weak(&m->last_log_ns, &last, now_ns))
+    {
+    }
+}
+
+// 日志记录距所属模块第一句打印的纳秒数，模块没有打印过(如内部汇总记录)时为0
+static int64_t log_entry_elapsed_ns(const log_entry_t *e)
+{
+    int64_t first = atomic_load_explicit(&e->module->first_log_ns, memory_order_relaxed);
+    return first == 0 ? 0 : e->mono_ns - first;
+}
+
+// 记一条溢出，写线程下次写文件时输出汇总
+static void count_log_overflow(module_info_t *m)
+{
+    atomic_fetch_add_explicit(&m->overflow_count, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&g_log_overflow_total, 1, memory_order_release);
+}
+
+// 丢弃最旧的一条已提交记录，须持有g_log_buf_mutex；最旧的记录尚未提交时返回-1
+static int discard_oldest_log_entry()
+{
+    size_t pos = atomic_load_explicit(&g_log_buffer.ring->read_index, memory_order_relaxed);
+    log_entry_t *e = (log_entry_t *)(g_log_buffer.arena + pos % g_log_buffer.capacity);
+    uint32_t size = atomic_load_explicit(&e->size, memory_order_acquire);
+    if (size == 0 || (size & LOG_RECORD_BUSY))
+    {
+        return -1;
+    }
+    if (!(size & LOG_RECORD_PAD))
+    {
+        count_log_overflow(e->module);
+    }
+    size &= ~LOG_RECORD_PAD;
+    memset(e, 0, size);
+    atomic_store_explicit(&g_log_buffer.ring->read_index, pos + size, memory_order_release);
+    return 0;
+}
+
+// 覆盖策略：由生产者丢弃最旧的记录腾出空间
+// 写线程只在渲染一个暂存区的记录期间持有消费锁，文件I/O时已放开，生产者等待的时间有上限；
+// 最旧的记录尚未提交时无法丢弃，返回NULL由调用方按丢弃新日志计数
+static log_entry_t *overwrite_oldest_log_entry(size_t size)
+{
+    log_entry_t *e;
+    while ((e = reserve_log_entry(size)) == NULL)
+    {
+        pthread_mutex_lock(&g_log_buf_mutex);
+        int ret = discard_oldest_log_entry();
+        pthread_mutex_unlock(&g_log_buf_mutex);
+        if (ret != 0)
+        {
+            return NULL;
+        }
+    }
+    return e;
+}
+
+// 阻塞策略：不论积压是否达到阈值都唤醒写线程，等待其归还空间，超时返回NULL
+static log_entry_t *wait_log_entry_space(size_t size)
+{
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += g_log_block_timeout_ms / 1000;
+    deadline.tv_nsec += (long)(g_log_block_timeout_ms % 1000) * 1000000;
+    if (deadline.tv_nsec >= 1000000000)
+    {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000;
+    }
+
+    log_entry_t *e;
+    pthread_mutex_lock(&g_log_space_mutex);
+    atomic_fetch_add(&g_log_space_waiters, 1);
+    while ((e = reserve_log_entry(size)) == NULL)
+    {
+        if (atomic_exchange(&g_writer_state, WRITER_BUSY) != WRITER_BUSY)
+        {
+            ring_writer_doorbell();
+        }
+        if (pthread_cond_timedwait(&g_log_space_cond, &g_log_space_mutex, &deadline) == ETIMEDOUT)
+        {
+            e = reserve_log_entry(size);
+            break;
+        }
+    }
+    atomic_fetch_sub(&g_log_space_waiters, 1);
+    pthread_mutex_unlock(&g_log_space_mutex);
+    return e;
+}
+
+static size_t render_text_entry(char *dst, const log_entry_t *e);
+
+// 溢写策略：生产者按文本格式同步写到<路径>.spill
+// 主日志文件由写线程按偏移写入(io_uring/映射)，生产者不能直接追加，故单独成文件
+static int spill_log_entry(const log_entry_t *e)
+{
+    char line[MAX_LOG_RECORD_LEN];
+    size_t len = render_text_entry(line, e);
+    pthread_mutex_lock(&g_log_spill_mutex);
+    if (g_log_spill_fd < 0)
+    {
+        char spill_path[MAX_LOG_FILE_PATH_LEN + 8];
+        snprintf(spill_path, sizeof(spill_path), "%s.spill", g_log_file_path);
+        g_log_spill_fd = open(spill_path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    }
+    int ret = g_log_spill_fd < 0 ? -1 : write_all(g_log_spill_fd, line, len);
+    pthread_mutex_unlock(&g_log_spill_mutex);
+    return ret;
+}
+
+static void append_log_entry(module_info_t *m, const char *log_content)
+{
+    time_t current_time = log_clock_now();
+    int64_t now_ns = log_mono_ns();
+    touch_module_info(m, now_ns);
+
+    size_t len = strnlen(log_content, MAX_LOG_ENTRY_LEN - 1);
+    size_t size = LOG_RECORD_SIZE(len);
+    _Alignas(LOG_RECORD_ALIGN) char spill_record[LOG_RECORD_SIZE(MAX_LOG_ENTRY_LEN)];
+    log_entry_t *e = reserve_log_entry(size);
+    if (e == NULL)
+    {
+        switch (g_log_overflow_policy)
+        {
+        case LOG_OVERFLOW_OVERWRITE_OLDEST:
+            e = overwrite_oldest_log_entry(size);
+            break;
+        case LOG_OVERFLOW_BLOCK:
+            e = wait_log_entry_space(size);
+            break;
+        case LOG_OVERFLOW_SPILL:
+            e = (log_entry_t *)spill_record;
+            break;
+        }
+        if (e == NULL)
+        {
+            count_log_overflow(m);
+            return;
+        }
+    }
+
+    e->timestamp = current_time;
+    e->module = m;
+    e->module_id = m->id;
+    e->mono_ns = now_ns;
+    e->log_len = len;
+    memcpy(e->log_content, log_content, len);
+
+    if (e == (log_entry_t *)spill_record)
+    {
+        if (spill_log_entry(e) != 0)
+        {
+            fprintf(stderr, "Failed to spill log entry.\n");
+        }
+        count_log_overflow(m);
+        return;
+    }
+    // 发布记录，写线程只消费已提交的记录
+    atomic_store_explicit(&e->size, size, memory_order_release);
+    notify_log_writer();
+}
+
+// 按模块句柄打印，无需字符串查找
+void print_to_log_buffer_by_handle(int handle, const char *log_content)
+{
+    if (handle < 0 || handle >= MAX_MODULE_NUM || g_module_by_id[handle] == NULL || log_content == NULL)
+    {
+        return;
+    }
+    append_log_entry(g_module_by_id[handle], log_content);
+}
+
+// 按模块名打印，保留给现有调用方，内部先查找(或注册)模块再按句柄打印
+void print_to_log_buffer(const char *module_name, const char *dependencies, const char *log_content)
+{
+    // check param
+    if(module_name == NULL || log_content == NULL)
+    {
+        return;
+    }
+
+    // 已登记的模块不加锁查找，只有登记新模块或合并新的依赖串时才持有模块链表锁
+    module_info_t *m = find_module_info(module_name, module_name_hash(module_name));
+    if (m == NULL || !module_dependencies_merged(m, dependencies))
+    {
+        pthread_mutex_lock(&g_module_list_mutex);
+        m = find_or_add_module_info(module_name, dependencies);
+        pthread_mutex_unlock(&g_module_list_mutex);
+    }
+    if (m == NULL)
+    {
+        fprintf(stderr, "Failed to add module info.\n");
+        return;
+    }
+    append_log_entry(m, log_content);
+}
+
+// 按"[时间][模块名][秒数]内容\n"渲染一条日志，返回渲染后的长度
+static size_t render_text_entry(char *dst, const log_entry_t *e)
+{
+    char *p = dst;
+
+    *p++ = '[';
+    p = stpcpy(p, format_log_time(e->timestamp));
+    *p++ = ']';
+    *p++ = '[';
+    p = stpcpy(p, e->module->module_name);
+    *p++ = ']';
+    *p++ = '[';
+    p += format_log_elapsed(p, log_entry_elapsed_ns(e));
+    *p++ = ']';
+    memcpy(p, e->log_content, e->log_len);
+    p += e->log_len;
+    *p++ = '\n';
+    return p - dst;
+}
+
+static char *put_bin_record_hdr(char *p, uint16_t type, uint16_t len)
+{
+    memcpy(p, &type, sizeof(type));
+    memcpy(p + 2, &len, sizeof(len));
+    return p + BIN_REC_HDR_LEN;
+}
+
+// 当前二进制文件是否已写出会话头(仅写线程访问)
+static bool g_bin_session_started = false;
+
+// 编码一条二进制日志，必要时先写出会话头和模块定义，返回编码后的长度
+static size_t render_binary_entry(char *dst, const log_entry_t *e)
+{
+    char *p = dst;
+    if (!g_bin_session_started)
+    {
+        uint32_t session[2] = {BIN_LOG_MAGIC, BIN_LOG_VERSION};
+        p = put_bin_record_hdr(p, BIN_REC_SESSION, sizeof(session));
+        memcpy(p, session, sizeof(session));
+        p += sizeof(session);
+        g_bin_session_started = true;
+    }
+    uint16_t id = e->module->id;
+    if (!e->module->announced)
+    {
+        size_t name_len = strlen(e->module->module_name);
+        p = put_bin_record_hdr(p, BIN_REC_MODULE, sizeof(id) + name_len);
+        memcpy(p, &id, sizeof(id));
+        memcpy(p + sizeof(id), e->module->module_name, name_len);
+        p += sizeof(id) + name_len;
+        e->module->announced = true;
+    }
+    int64_t timestamp = e->timestamp;
+    int64_t elapsed_ns = log_entry_elapsed_ns(e);
+    p = put_bin_record_hdr(p, BIN_REC_LOG, sizeof(timestamp) + sizeof(id) + sizeof(elapsed_ns) + e->log_len);
+    memcpy(p, &timestamp, sizeof(timestamp));
+    p += sizeof(timestamp);
+    memcpy(p, &id, sizeof(id));
+    p += sizeof(id);
+    memcpy(p, &elapsed_ns, sizeof(elapsed_ns));
+    p += sizeof(elapsed_ns);
+    memcpy(p, e->log_content, e->log_len);
+    p += e->log_len;
+    return p - dst;
+}
+
+// 日志文件格式及对应的渲染函数
+static int g_log_format = LOG_FORMAT_TEXT;
+static size_t (*render_log_entry)(char *dst, const log_entry_t *e) = render_text_entry;
+
+// 设置日志文件格式，须在启动写线程前调用
+void set_log_format(int format)
+{
+    g_log_format = format;
+    render_log_entry = format == LOG_FORMAT_BINARY ? render_binary_entry : render_text_entry;
+}
+
+// Chrome trace(Perfetto可加载)导出文件，路径为空时不导出；仅写线程访问
+static char g_trace_file_path[MAX_LOG_FILE_PATH_LEN] = "";
+static FILE *g_trace_file = NULL;
+
+// 设置trace导出文件路径，NULL关闭导出，须在启动写线程前调用
+void set_log_trace_file(const char *trace_path)
+{
+    snprintf(g_trace_file_path, MAX_LOG_FILE_PATH_LEN, "%s", trace_path != NULL ? trace_path : "");
+}
+
+// 输出JSON字符串(含引号)，转义引号、反斜杠和控制字符
+static void trace_put_string(FILE *trace_file, const char *str, size_t len)
+{
+    fputc('"', trace_file);
+    for (size_t i = 0; i < len; i++)
+    {
+        unsigned char c = str[i];
+        if (c == '"' || c == '\\')
+        {
+            fputc('\\', trace_file);
+            fputc(c, trace_file);
+        }
+        else if (c < 0x20)
+        {
+            fprintf(trace_file, "\\u%04x", c);
+        }
+        else
+        {
+            fputc(c, trace_file);
+        }
+    }
+    fputc('"', trace_file);
+}
+
+// 每条日志导出为所属模块轨道上的瞬时事件，随写文件流式输出，不另存副本
+static void trace_log_entry(FILE *trace_file, const log_entry_t *e)
+{
+    fputs("{\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"name\":", trace_file);
+    trace_put_string(trace_file, e->log_content, e->log_len);
+    fprintf(trace_file, ",\"tid\":%d,\"ts\":%lld},\n", e->module->id, (long long)e->mono_ns / 1000);
+}
+
+// 模块导出为时长切片，依赖关系导出为从依赖模块结束指向本模块开始的flow事件
+int ouput_log_module_trace(FILE *trace_file)
+{
+    if (trace_file == NULL)
+    {
+        return -1;
+    }
+    int flow_id = 0;
+    for (module_info_t *p = g_module_list_head; p != NULL; p = p->next)
+    {
+        int64_t first_log_ns = p->first_log_ns;
+        int64_t last_log_ns = p->last_log_ns;
+        if (first_log_ns == 0)
+        {
+            continue;
+        }
+        fprintf(trace_file, "{\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"name\":\"thread_name\",\"args\":{\"name\":", p->id);
+        trace_put_string(trace_file, p->module_name, strlen(p->module_name));
+        fputs("}},\n{\"ph\":\"X\",\"pid\":1,\"name\":", trace_file);
+        trace_put_string(trace_file, p->module_name, strlen(p->module_name));
+        fprintf(trace_file, ",\"tid\":%d,\"ts\":%lld,\"dur\":%lld},\n", p->id,
+                (long long)first_log_ns / 1000, (long long)(last_log_ns - first_log_ns) / 1000);
+        for (int id = 0; id < g_module_count; id++)
+        {
+            module_info_t *d = g_module_by_id[id];
+            if (!(p->dependencies[id / 64] & (1ull << (id % 64))) || d == p || d->first_log_ns == 0)
+            {
+                continue;
+            }
+            flow_id++;
+            fprintf(trace_file, "{\"ph\":\"s\",\"pid\":1,\"name\":\"depends\",\"cat\":\"dependency\",\"id\":%d,\"tid\":%d,\"ts\":%lld},\n",
+                    flow_id, d->id, (long long)d->last_log_ns / 1000);
+            fprintf(trace_file, "{\"ph\":\"f\",\"bp\":\"e\",\"pid\":1,\"name\":\"depends\",\"cat\":\"dependency\",\"id\":%d,\"tid\":%d,\"ts\":%lld},\n",
+                    flow_id, p->id, (long long)first_log_ns / 1000);
+        }
+    }
+    // 以无逗号的元数据事件收尾，使数组成为合法JSON
+    fputs("{\"ph\":\"M\",\"pid\":1,\"name\":\"process_name\",\"args\":{\"name\":\"boot\"}}\n]\n", trace_file);
+    return 0;
+}
+
+// 新文件(或新分段)从流头重新开始，不引用之前文件的内容
+static void reset_log_compress_stream(log_compress_t *c)
+{
+    c->stream_started = false;
+    c->hist_len = 0;
+    if (c->hash != NULL)
+    {
+        memset(c->hash, 0, sizeof(uint32_t) << LOG_LZ_HASH_BITS);
+    }
+}
+
+static unsigned char *put_lz_length(unsigned char *op, size_t len)
+{
+    for (; len >= 255; len -= 255)
+    {
+        *op++ = 255;
+    }
+    *op++ = len;
+    return op;
+}
+
+// 写出一个序列：token(高4位字面量长度，低4位匹配长度-4，15表示后面有扩展长度) + 字面量 + 2字节距离
+// 帧的最后一个序列只有字面量
+static unsigned char *put_lz_sequence(unsigned char *op, const unsigned char *lit, size_t lit_len, size_t dist, size_t match_len)
+{
+    unsigned char *token = op++;
+    *token = (lit_len >= 15 ? 15 : lit_len) << 4;
+    if (lit_len >= 15)
+    {
+        op = put_lz_length(op, lit_len - 15);
+    }
+    memcpy(op, lit, lit_len);
+    op += lit_len;
+    if (match_len == 0)
+    {
+        return op;
+    }
+    *op++ = dist & 0xff;
+    *op++ = dist >> 8;
+    size_t m = match_len - LOG_LZ_MIN_MATCH;
+    *token |= m >= 15 ? 15 : m;
+    if (m >= 15)
+    {
+        op = put_lz_length(op, m - 15);
+    }
+    return op;
+}
+
+static uint32_t log_lz_checksum(const unsigned char *p, size_t len)
+{
+    uint32_t h = 2166136261u; // FNV-1a
+    for (size_t i = 0; i < len; i++)
+    {
+        h = (h ^ p[i]) * 16777619u;
+    }
+    return h;
+}
+
+// 把一个暂存区压缩为一帧写入dst(当前文件的第一帧前加流头)，返回写入的长度
+static size_t compress_log_frame(log_compress_t *c, const char *src, size_t len, char *dst)
+{
+    unsigned char *op = (unsigned char *)dst;
+    if (!c->stream_started)
+    {
+        uint32_t stream_hdr[2] = {LOG_LZ_MAGIC, LOG_LZ_WINDOW};
+        memcpy(op, stream_hdr, sizeof(stream_hdr));
+        op += LOG_LZ_STREAM_HDR_LEN;
+        c->stream_started = true;
+    }
+    // 只保留最近一个窗口的历史，本帧原文接在其后，匹配可跨帧
+    if (c->hist_len > LOG_LZ_WINDOW)
+    {
+        size_t drop = c->hist_len - LOG_LZ_WINDOW;
+        memmove(c->hist, c->hist + drop, LOG_LZ_WINDOW);
+        c->hist_pos += drop;
+        c->hist_len = LOG_LZ_WINDOW;
+    }
+    memcpy(c->hist + c->hist_len, src, len);
+    const unsigned char *buf = c->hist;
+    size_t pos = c->hist_len, anchor = pos, end = c->hist_len + len;
+    unsigned char *frame = op;
+    unsigned char *payload = frame + LOG_LZ_FRAME_HDR_LEN;
+    op = payload;
+    while (pos + LOG_LZ_MIN_MATCH <= end)
+    {
+        uint32_t seq;
+        memcpy(&seq, buf + pos, sizeof(seq));
+        uint32_t h = (seq * 2654435761u) >> (32 - LOG_LZ_HASH_BITS);
+        uint32_t dist = (uint32_t)(c->hist_pos + pos) - c->hash[h];
+        c->hash[h] = c->hist_pos + pos;
+        // 哈希表中可能是已移出窗口或碰撞的位置，以实际比较为准
+        if (dist > 0 && dist < LOG_LZ_WINDOW && dist <= pos && memcmp(buf + pos - dist, buf + pos, LOG_LZ_MIN_MATCH) == 0)
+        {
+            size_t match_len = LOG_LZ_MIN_MATCH;
+            while (pos + match_len < end && buf[pos + match_len - dist] == buf[pos + match_len])
+            {
+                match_len++;
+            }
+            op = put_lz_sequence(op, buf + anchor, pos - anchor, dist, match_len);
+            pos += match_len;
+            anchor = pos;
+            continue;
+        }
+        pos++;
+    }
+    op = put_lz_sequence(op, buf + anchor, end - anchor, 0, 0);
+    c->hist_len = end;
+
+    uint32_t comp_len = op - payload;
+    if (comp_len >= len)
+    {
+        memcpy(payload, src, len);
+        op = payload + len;
+        comp_len = len | LOG_LZ_FRAME_STORED;
+    }
+    uint32_t frame_hdr[3] = {len, comp_len, log_lz_checksum(payload, op - payload)};
+    memcpy(frame, frame_hdr, sizeof(frame_hdr));
+    c->raw_bytes += len;
+    c->out_bytes += op - (unsigned char *)dst;
+    return op - (unsigned char *)dst;
+}
+
+// 写出一个渲染好的暂存区(开启压缩时写出压缩后的帧)；异步后端下提交后切换到另一个暂存区继续渲染
+static int emit_staging(int fd, size_t used)
+{
+    char *buf = g_log_buffer.staging[g_log_buffer.staging_index];
+    if (g_log_compress.enabled)
+    {
+        char *out = g_log_compress.out[g_log_buffer.staging_index];
+        used = compress_log_frame(&g_log_compress, buf, used, out);
+        buf = out;
+    }
+    if (fd == g_log_rotation.fd)
+    {
+        g_log_rotation.bytes += used;
+    }
+    if (g_log_backend != LOG_BACKEND_IO_URING)
+    {
+        return write_all(fd, buf, used);
+    }
+    int ret = log_uring_wait(&g_log_uring);
+    if (log_uring_submit_write(&g_log_uring, fd, buf, used) != 0)
+    {
+        return ret | write_all(fd, buf, used);
+    }
+    g_log_buffer.staging_index ^= 1;
+    return ret;
+}
+
+// 等待异步后端的在途写入完成，之后才能经stdio写入或关闭文件
+int wait_log_write_complete()
+{
+    pthread_mutex_lock(&g_log_write_mutex);
+    int ret = log_uring_wait(&g_log_uring);
+    pthread_mutex_unlock(&g_log_write_mutex);
+    return ret;
+}
+
+// 创建下一段并预分配到段上限(不改变文件长度，仍可追加写)，轮转时不必边写边分配
+static void prepare_next_log_segment(const log_rotation_t *r)
+{
+    char next_path[MAX_LOG_FILE_PATH_LEN + 8];
+    snprintf(next_path, sizeof(next_path), "%s.next", g_log_file_path);
+    int fd = open(next_path, O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0)
+    {
+        return;
+    }
+    // 文件系统不支持时照常按块扩展
+    if (fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, r->max_bytes) != 0)
+    {
+        fprintf(stderr, "Failed to preallocate log segment: %s\n", next_path);
+    }
+    close(fd);
+}
+
+// 写线程打开日志文件后调用，记录当前段的描述符和长度，预分配当前段并准备下一段
+static void open_log_segment(log_rotation_t *r, FILE *log_file)
+{
+    if (r->max_bytes == 0)
+    {
+        return;
+    }
+    r->fd = fileno(log_file);
+    r->bytes = lseek(r->fd, 0, SEEK_END);
+    if ((size_t)r->bytes < r->max_bytes)
+    {
+        fallocate(r->fd, FALLOC_FL_KEEP_SIZE, r->bytes, r->max_bytes - r->bytes);
+    }
+    prepare_next_log_segment(r);
+}
+
+// 写线程退出前调用，释放当前段预分配但未用到的空间，删除未用的下一段
+static void close_log_segment(log_rotation_t *r, FILE *log_file)
+{
+    if (r->fd < 0)
+    {
+        return;
+    }
+    fflush(log_file);
+    if (ftruncate(r->fd, lseek(r->fd, 0, SEEK_END)) != 0)
+    {
+        fprintf(stderr, "Failed to truncate log segment.\n");
+    }
+    char next_path[MAX_LOG_FILE_PATH_LEN + 8];
+    snprintf(next_path, sizeof(next_path), "%s.next", g_log_file_path);
+    unlink(next_path);
+    r->fd = -1;
+}
+
+// 写入当前记录后当前段会超过上限时返回true；空段总是可写，单条记录不会被拆到两段
+static bool log_segment_full(const log_rotation_t *r, off_t len)
+{
+    return r->max_bytes > 0 && len > 0 && (size_t)len + MAX_LOG_RECORD_LEN > r->max_bytes;
+}
+
+// 轮转到下一段：写出已渲染的部分，旧段依次改名，预分配好的<路径>.next改名为当前段
+static int rotate_log_segment(log_rotation_t *r, size_t *used, bool mapped)
+{
+    int ret = 0;
+    if (*used > 0)
+    {
+        ret = emit_staging(r->fd, *used);
+        *used = 0;
+    }
+    ret |= log_uring_wait(&g_log_uring);
+    if (mapped)
+    {
+        r->bytes = g_log_mmap.data_len;
+        log_mmap_close(&g_log_mmap);
+    }
+    // 释放当前段预分配但未用到的空间
+    if (ftruncate(r->fd, r->bytes) != 0)
+    {
+        ret = -1;
+    }
+
+    char from[MAX_LOG_FILE_PATH_LEN + 16], to[MAX_LOG_FILE_PATH_LEN + 16];
+    for (int i = r->retained; i > 0; i--)
+    {
+        if (i == 1)
+        {
+            snprintf(from, sizeof(from), "%s", g_log_file_path);
+        }
+        else
+        {
+            snprintf(from, sizeof(from), "%s.%d", g_log_file_path, i - 1);
+        }
+        snprintf(to, sizeof(to), "%s.%d", g_log_file_path, i);
+        rename(from, to); // 旧段不足保留数时源文件不存在，忽略
+    }
+    // 不保留旧段时直接以下一段覆盖当前段
+    snprintf(from, sizeof(from), "%s.next", g_log_file_path);
+    if (rename(from, g_log_file_path) != 0)
+    {
+        unlink(g_log_file_path);
+    }
+    int fd = open(g_log_file_path, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0 || dup2(fd, r->fd) < 0)
+    {
+        fprintf(stderr, "Failed to rotate log file: %s\n", g_log_file_path);
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+        return -1;
+    }
+    close(fd);
+    r->bytes = lseek(r->fd, 0, SEEK_END);
+
+    // 二进制格式下每段都从会话头开始并重新写出模块定义，压缩流也从流头重新开始，可单独解码
+    g_bin_session_started = false;
+    reset_log_compress_stream(&g_log_compress);
+    pthread_mutex_lock(&g_module_list_mutex);
+    for (module_info_t *m = g_module_list_head; m != NULL; m = m->next)
+    {
+        m->announced = false;
+    }
+    pthread_mutex_unlock(&g_module_list_mutex);
+
+    if (mapped && log_mmap_open(&g_log_mmap, g_log_file_path) != 0)
+    {
+        ret = -1;
+    }
+    prepare_next_log_segment(r);
+    return ret;
+}
+
+// 渲染一条记录：映射模式直接渲染进文件映射区，否则追加到暂存区，暂存区将满时先写出
+// 当前段将超过上限时先轮转，记录所在的段由渲染前决定
+static int render_to_output(int fd, size_t *used, bool mapped, const log_entry_t *e)
+{
+    int ret = 0;
+    if (fd == g_log_rotation.fd &&
+        log_segment_full(&g_log_rotation, mapped ? g_log_mmap.data_len : g_log_rotation.bytes + (off_t)*used))
+    {
+        ret = rotate_log_segment(&g_log_rotation, used, mapped);
+        if (mapped && g_log_mmap.fd < 0)
+        {
+            return -1;
+        }
+    }
+    if (mapped)
+    {
+        char *dst = log_mmap_reserve(&g_log_mmap, MAX_LOG_RECORD_LEN);
+        if (dst == NULL)
+        {
+            return -1;
+        }
+        g_log_mmap.data_len += render_log_entry(dst, e);
+        return ret;
+    }
+    if (*used + MAX_LOG_RECORD_LEN > LOG_STAGING_BUF_LEN)
+    {
+        ret = emit_staging(fd, *used);
+        *used = 0;
+    }
+    *used += render_log_entry(g_log_buffer.staging[g_log_buffer.staging_index] + *used, e);
+    return ret;
+}
+
+// 自上次写文件以来有日志因缓冲区满被丢弃或溢写时，生成一条按模块汇总的记录，否则返回NULL
+static log_entry_t *make_overflow_summary(log_entry_t *e)
+{
+    size_t total = atomic_load_explicit(&g_log_overflow_total, memory_order_acquire);
+    if (total == g_log_overflow_reported)
+    {
+        return NULL;
+    }
+    static const char *actions[] = {"dropped", "overwritten or dropped", "dropped after timeout", "spilled"};
+    g_log_overflow_reported = total;
+
+    // 总数取各模块实际读到的增量之和，与括号中的明细一致；g_log_overflow_total只用于判断有无新溢出
+    char detail[MAX_LOG_ENTRY_LEN];
+    char *d = detail;
+    char *detail_end = detail + sizeof(detail);
+    size_t sum = 0;
+    const char *sep = " (";
+    pthread_mutex_lock(&g_module_list_mutex);
+    if (g_log_overflow_module == NULL)
+    {
+        g_log_overflow_module = find_or_add_module_info("bootlog", NULL);
+    }
+    for (module_info_t *m = g_module_list_head; m != NULL; m = m->next)
+    {
+        size_t n = atomic_load_explicit(&m->overflow_count, memory_order_relaxed);
+        if (n == m->overflow_reported)
+        {
+            continue;
+        }
+        if (d < detail_end)
+        {
+            d += snprintf(d, detail_end - d, "%s%s %zu", sep, m->module_name, n - m->overflow_reported);
+            sep = ", ";
+        }
+        sum += n - m->overflow_reported;
+        m->overflow_reported = n;
+    }
+    pthread_mutex_unlock(&g_module_list_mutex);
+    if (sum == 0 || g_log_overflow_module == NULL)
+    {
+        return NULL; // 本次的溢出已在上一条汇总中按模块计入
+    }
+
+    char *p = e->log_content;
+    char *end = e->log_content + MAX_LOG_ENTRY_LEN - 1;
+    p += snprintf(p, end - p, "log buffer full: %zu entries %s%s)", sum, actions[g_log_overflow_policy], detail);
+    e->timestamp = log_clock_now();
+    e->module = g_log_overflow_module;
+    e->module_id = g_log_overflow_module->id;
+    e->mono_ns = log_mono_ns();
+    e->log_len = p < end ? p - e->log_content : end - e->log_content;
+    return e;
+}
+
+// 唤醒阻塞策略下等待空间的生产者；等待带超时，即使错过这次广播也不会永久阻塞
+static void wake_log_space_waiters()
+{
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load(&g_log_space_waiters) > 0)
+    {
+        pthread_mutex_lock(&g_log_space_mutex);
+        pthread_cond_broadcast(&g_log_space_cond);
+        pthread_mutex_unlock(&g_log_space_mutex);
+    }
+}
+
+// 将writer_thread_func中写文件的部分抽出来，方便单元测试
+// 已提交的日志先渲染到暂存区，暂存区满或本批结束时一次write写入文件
+int write_log_content_to_file(FILE *file)
+{
+    int ret = 0;
+    if (file == NULL)
+    {
+        return -1;
+    }
+
+    // 写文件的调用方之间串行；消费锁只在渲染记录时持有，暂存区写文件期间放开，
+    // 覆盖策略下丢弃最旧记录的生产者不必等待文件I/O
+    pthread_mutex_lock(&g_log_write_mutex);
+    fflush(file); // 保证与其他经stdio写入的内容顺序一致
+    int fd = fileno(file);
+    size_t used = 0;
+    bool mapped = g_log_backend == LOG_BACKEND_MMAP && g_log_mmap.fd >= 0;
+    pthread_mutex_lock(&g_log_buf_mutex);
+    size_t pos = atomic_load_explicit(&g_log_buffer.ring->read_index, memory_order_relaxed);
+    while (1)
+    {
+        if (!mapped && used + MAX_LOG_RECORD_LEN > LOG_STAGING_BUF_LEN)
+        {
+            pthread_mutex_unlock(&g_log_buf_mutex);
+            wake_log_space_waiters();
+            ret |= emit_staging(fd, used);
+            used = 0;
+            pthread_mutex_lock(&g_log_buf_mutex);
+            // 放开期间生产者可能丢弃了最旧的记录
+            pos = atomic_load_explicit(&g_log_buffer.ring->read_index, memory_order_relaxed);
+        }
+        log_entry_t *e = (log_entry_t *)(g_log_buffer.arena + pos % g_log_buffer.capacity);
+        uint32_t size = atomic_load_explicit(&e->size, memory_order_acquire);
+        if (size == 0 || (size & LOG_RECORD_BUSY))
+        {
+            break; // 记录尚未提交
+        }
+        if (size & LOG_RECORD_PAD)
+        {
+            size &= ~LOG_RECORD_PAD;
+            memset(e, 0, size);
+            pos += size;
+            atomic_store_explicit(&g_log_buffer.ring->read_index, pos, memory_order_release);
+            continue;
+        }
+        int render_ret = render_to_output(fd, &used, mapped, e);
+        if (render_ret != 0 && mapped)
+        {
+            ret = -1;
+            break;
+        }
+        ret |= render_ret;
+        if (g_trace_file != NULL)
+        {
+            trace_log_entry(g_trace_file, e);
+        }
+
+        // 清零后归还空间，下一圈生产者据size为0判断未提交
+        memset(e, 0, size);
+        pos += size;
+        atomic_store_explicit(&g_log_buffer.ring->read_index, pos, memory_order_release);
+    }
+    pthread_mutex_unlock(&g_log_buf_mutex);
+    wake_log_space_waiters();
+
+    _Alignas(LOG_RECORD_ALIGN) char summary_record[LOG_RECORD_SIZE(MAX_LOG_ENTRY_LEN)];
+    log_entry_t *summary = make_overflow_summary((log_entry_t *)summary_record);
+    if (summary != NULL)
+    {
+        ret |= render_to_output(fd, &used, mapped, summary);
+    }
+    if (used > 0)
+    {
+        ret |= emit_staging(fd, used);
+    }
+    pthread_mutex_unlock(&g_log_write_mutex);
+
+    return ret;
+}
+
+
+int ouput_log_module_list(FILE *log_file)
+{
+    module_info_t *p = NULL;
+    if (log_file == NULL)
+    {
+        return -1;
+    }
+    fprintf(log_file, "[%s][%s][%s][%s]%s\n", "module", "first_log_time", "last_log_time", "diff", "dependencies");
+    p = g_module_list_head;
+    while (p != NULL)
+    {
+        int64_t first_log_ns = p->first_log_ns;
+        int64_t last_log_ns = p->last_log_ns;
+        if (first_log_ns == 0)
+        {
+            p = p->next; // 仅作为依赖登记、自身没有打印的模块不输出
+            continue;
+        }
+        char first_timestr[20], last_timestr[20];
+        struct tm tm_log;
+        time_t first_log_time = log_mono_to_wall(first_log_ns);
+        time_t last_log_time = log_mono_to_wall(last_log_ns);
+        strftime(first_timestr, sizeof(first_timestr), "%Y-%m-%d %H:%M:%S", localtime_r(&first_log_time, &tm_log));
+        strftime(last_timestr, sizeof(last_timestr), "%Y-%m-%d %H:%M:%S", localtime_r(&last_log_time, &tm_log));
+        fprintf(log_file, "[%s][%s][%s][%.2lf]",
+                p->module_name,
+                first_timestr,
+                last_timestr,
+                (last_log_ns - first_log_ns) / 1e9);
+        // 依赖集合按模块登记顺序拼接为逗号分隔的字符串
+        const char *sep = "";
+        for (int id = 0; id < g_module_count; id++)
+        {
+            if (p->dependencies[id / 64] & (1ull << (id % 64)))
+            {
+                fprintf(log_file, "%s%s", sep, g_module_by_id[id]->module_name);
+                sep = ",";
+            }
+        }
+        fputc('\n', log_file);
+        p = p->next;
+    }
+
+    return 0;
+}
+
+static const module_info_t *const *g_slack_sort_modules;
+static const double *g_slack_sort_slack;
+
+// 按松弛时间升序，相同时按耗时降序
+static int compare_module_slack(const void *a, const void *b)
+{
+    int x = *(const int *)a, y = *(const int *)b;
+    if (g_slack_sort_slack[x] != g_slack_sort_slack[y])
+    {
+        return g_slack_sort_slack[x] < g_slack_sort_slack[y] ? -1 : 1;
+    }
+    int64_t dx = g_slack_sort_modules[x]->last_log_ns - g_slack_sort_modules[x]->first_log_ns;
+    int64_t dy = g_slack_sort_modules[y]->last_log_ns - g_slack_sort_modules[y]->first_log_ns;
+    return dx < dy ? 1 : (dx > dy ? -1 : 0);
+}
+
+// 根据模块首末打印时间和依赖关系构建依赖图，输出启动关键路径和各模块的启动松弛时间
+// 模块以第一句打印为开始、最后一句打印为结束；松弛时间为该模块可推迟而不影响启动完成的秒数
+int ouput_log_critical_path(FILE *log_file)
+{
+    if (log_file == NULL)
+    {
+        return -1;
+    }
+    int n = g_module_count;
+    double *start = calloc(n, sizeof(double));
+    double *finish = calloc(n, sizeof(double));
+    double *latest_finish = calloc(n, sizeof(double));
+    double *slack = calloc(n, sizeof(double));
+    int *indegree = calloc(n, sizeof(int));
+    int *order = calloc(n, sizeof(int));
+    int *critical_pred = calloc(n, sizeof(int));
+    int *path = calloc(n, sizeof(int));
+    int ret = -1;
+    if (n == 0 || start == NULL || finish == NULL || latest_finish == NULL || slack == NULL ||
+        indegree == NULL || order == NULL || critical_pred == NULL || path == NULL)
+    {
+        goto out;
+    }
+
+    // 只分析有打印的模块，时间以最早打印的模块为起点
+    int64_t boot_begin = 0;
+    for (int i = 0; i < n; i++)
+    {
+        int64_t first = g_module_by_id[i]->first_log_ns;
+        if (first != 0 && (boot_begin == 0 || first < boot_begin))
+        {
+            boot_begin = first;
+        }
+    }
+#define MODULE_LOGGED(i) (g_module_by_id[i]->first_log_ns != 0)
+#define MODULE_DEPENDS(v, u) ((u) != (v) && (g_module_by_id[v]->dependencies[(u) / 64] & (1ull << ((u) % 64))))
+    for (int v = 0; v < n; v++)
+    {
+        critical_pred[v] = -1;
+        if (!MODULE_LOGGED(v))
+        {
+            continue;
+        }
+        start[v] = (g_module_by_id[v]->first_log_ns - boot_begin) / 1e9;
+        finish[v] = (g_module_by_id[v]->last_log_ns - boot_begin) / 1e9;
+        for (int u = 0; u < n; u++)
+        {
+            indegree[v] += MODULE_LOGGED(u) && MODULE_DEPENDS(v, u);
+        }
+    }
+
+    // Kahn拓扑排序，依赖先于被依赖者；排不进去的模块处于依赖环中
+    int count = 0, head = 0;
+    for (int v = 0; v < n; v++)
+    {
+        if (MODULE_LOGGED(v) && indegree[v] == 0)
+        {
+            order[count++] = v;
+        }
+    }
+    while (head < count)
+    {
+        int u = order[head++];
+        for (int v = 0; v < n; v++)
+        {
+            if (MODULE_LOGGED(v) && MODULE_DEPENDS(v, u))
+            {
+                // 关键前驱：依赖中最晚结束的模块
+                if (critical_pred[v] < 0 || finish[u] > finish[critical_pred[v]])
+                {
+                    critical_pred[v] = u;
+                }
+                if (--indegree[v] == 0)
+                {
+                    order[count++] = v;
+                }
+            }
+        }
+    }
+
+    // 逆拓扑序计算最晚结束时间：被依赖者的最晚开始时间中的最小值，无被依赖者时为启动完成时间
+    double boot_end = 0;
+    int last_module = -1;
+    for (int i = 0; i < count; i++)
+    {
+        if (last_module < 0 || finish[order[i]] > boot_end)
+        {
+            boot_end = finish[order[i]];
+            last_module = order[i];
+        }
+    }
+    for (int i = count - 1; i >= 0; i--)
+    {
+        int u = order[i];
+        latest_finish[u] = boot_end;
+        for (int v = 0; v < n; v++)
+        {
+            if (MODULE_LOGGED(v) && indegree[v] == 0 && MODULE_DEPENDS(v, u) &&
+                latest_finish[v] - (finish[v] - start[v]) < latest_finish[u])
+            {
+                latest_finish[u] = latest_finish[v] - (finish[v] - start[v]);
+            }
+        }
+        // 与关键路径上的wait同理，被依赖者在本模块结束前就已开始时算出的负值按0计
+        slack[u] = latest_finish[u] > finish[u] ? latest_finish[u] - finish[u] : 0;
+    }
+
+    fprintf(log_file, "[%s][%.2lf]\n", "critical_path", boot_end);
+    fprintf(log_file, "[%s][%s][%s][%s][%s][%s]\n", "module", "start", "finish", "duration", "wait", "overlap");
+    // 从最晚结束的模块沿关键前驱回溯，再正序输出
+    // 首末打印时间只是模块实际运行区间的近似，模块可能在关键前驱最后一句打印之前就已开始打印；
+    // wait为关键前驱结束到本模块开始的空闲时间，不为负，重叠的部分单独记在overlap列
+    int path_len = 0;
+    for (int v = last_module; v >= 0; v = critical_pred[v])
+    {
+        path[path_len++] = v;
+    }
+    for (int i = path_len - 1; i >= 0; i--)
+    {
+        int v = path[i];
+        int pred = critical_pred[v];
+        double gap = pred >= 0 ? start[v] - finish[pred] : start[v];
+        fprintf(log_file, "[%s][%.2lf][%.2lf][%.2lf][%.2lf][%.2lf]\n", g_module_by_id[v]->module_name, start[v],
+                finish[v], finish[v] - start[v], gap > 0 ? gap : 0, gap < 0 ? -gap : 0);
+    }
+
+    // 松弛时间为0的模块直接决定启动完成时间
+    fprintf(log_file, "[%s][%s][%s]\n", "module", "slack", "duration");
+    g_slack_sort_modules = (const module_info_t *const *)g_module_by_id;
+    g_slack_sort_slack = slack;
+    qsort(order, count, sizeof(int), compare_module_slack);
+    for (int i = 0; i < count; i++)
+    {
+        int v = order[i];
+        fprintf(log_file, "[%s][%.2lf][%.2lf]\n", g_module_by_id[v]->module_name, slack[v], finish[v] - start[v]);
+    }
+    for (int v = 0; v < n; v++)
+    {
+        if (MODULE_LOGGED(v) && indegree[v] > 0)
+        {
+            fprintf(log_file, "[%s][%s]\n", g_module_by_id[v]->module_name, "dependency cycle");
+        }
+    }
+#undef MODULE_DEPENDS
+#undef MODULE_LOGGED
+    ret = 0;
+
+out:
+    free(start);
+    free(finish);
+    free(latest_finish);
+    free(slack);
+    free(indegree);
+    free(order);
+    free(critical_pred);
+    free(path);
+    return ret;
+}
+
+void *writer_thread_func(void *arg)
+{
+    FILE *log_file = NULL;
+
+    if (g_log_compress.enabled && g_log_backend == LOG_BACKEND_MMAP)
+    {
+        g_log_backend = LOG_BACKEND_SYNC;
+    }
+
+    if (g_log_backend == LOG_BACKEND_MMAP && log_mmap_open(&g_log_mmap, g_log_file_path) != 0)
+    {
+        fprintf(stderr, "Failed to map log file: %s\n", g_log_file_path);
+        g_log_backend = LOG_BACKEND_SYNC;
+    }
+    log_file = fopen(g_log_file_path, "a");
+    if (log_file == NULL)
+    {
+        fprintf(stderr, "Failed to open log file: %s\n", g_log_file_path);
+        log_mmap_close(&g_log_mmap);
+        return NULL;
+    }
+    open_log_segment(&g_log_rotation, log_file);
+
+    if (g_trace_file_path[0] != '\0')
+    {
+        // JSON数组格式，中途崩溃时未闭合的数组仍可被trace查看器加载
+        g_trace_file = fopen(g_trace_file_path, "w");
+        if (g_trace_file != NULL)
+        {
+            fputs("[\n", g_trace_file);
+        }
+    }
+
+    struct pollfd pfd = {.fd = g_writer_doorbell_fd, .events = POLLIN};
+    // 积压达到阈值但最旧的记录尚未提交时，写一次没有进展；此时按未满阈值处理，
+    // 等生产者提交时敲门铃或空闲超时后再试，生产者在预留和提交之间停住(或崩溃)时不会空转
+    bool stalled = false;
+    while (atomic_load(&g_writer_thread_running))
+    {
+        size_t count = get_log_buffer_used();
+        if (count >= (size_t)g_log_flush_threshold && !stalled)
+        {
+            size_t read_index = atomic_load_explicit(&g_log_buffer.ring->read_index, memory_order_relaxed);
+            write_log_content_to_file(log_file);
+            stalled = atomic_load_explicit(&g_log_buffer.ring->read_index, memory_order_relaxed) == read_index;
+            continue;
+        }
+
+        // 先公布休眠状态再复查，避免与生产者的通知错过
+        int state = count == 0 ? WRITER_WAIT_EMPTY : WRITER_WAIT_PARTIAL;
+        atomic_store(&g_writer_state, state);
+        count = get_log_buffer_used();
+        if ((state == WRITER_WAIT_EMPTY && count > 0) || (count >= (size_t)g_log_flush_threshold && !stalled))
+        {
+            atomic_store(&g_writer_state, WRITER_BUSY);
+            continue;
+        }
+
+        int ret = poll(&pfd, 1, state == WRITER_WAIT_EMPTY ? -1 : g_log_flush_idle_ms);
+        atomic_store(&g_writer_state, WRITER_BUSY);
+        stalled = false;
+        if (ret > 0)
+        {
+            uint64_t rings;
+            if (read(g_writer_doorbell_fd, &rings, sizeof(rings)) < 0)
+            {
+                fprintf(stderr, "Failed to read writer doorbell.\n");
+            }
+        }
+        else if (ret == 0)
+        {
+            // 空闲超时，写入未满阈值的部分批次
+            write_log_content_to_file(log_file);
+        }
+    }
+    write_log_content_to_file(log_file);
+    wait_log_write_complete();
+    log_mmap_close(&g_log_mmap); // 截断到实际长度后，模块列表经stdio追加到文件尾
+
+    if (g_log_format == LOG_FORMAT_BINARY || g_log_compress.enabled)
+    {
+        // 二进制或压缩文件中不混入文本，模块列表单独写到<路径>.modules
+        char module_list_path[MAX_LOG_FILE_PATH_LEN + 8];
+        snprintf(module_list_path, sizeof(module_list_path), "%s.modules", g_log_file_path);
+        FILE *module_file = fopen(module_list_path, "a");
+        ouput_log_module_list(module_file);
+        ouput_log_critical_path(module_file);
+        if (module_file != NULL)
+        {
+            fclose(module_file);
+        }
+    }
+    else
+    {
+        ouput_log_module_list(log_file);
+        ouput_log_critical_path(log_file);
+    }
+    if (g_trace_file != NULL)
+    {
+        ouput_log_module_trace(g_trace_file);
+        fclose(g_trace_file);
+        g_trace_file = NULL;
+    }
+
+    close_log_segment(&g_log_rotation, log_file);
+    fclose(log_file);
+
+    return NULL;
+}
+
+// stop thread
+void stop_log_writer_thread()
+{
+    if (!g_writer_thread_running)
+    {
+        return;
+    }
+    g_writer_thread_running = false;
+    ring_writer_doorbell();
+    pthread_join(g_writer_thread, NULL);
+    close(g_writer_doorbell_fd);
+    g_writer_doorbell_fd = -1;
+}
+
+int start_log_writer_thread()
+{
+    g_writer_doorbell_fd = eventfd(0, EFD_CLOEXEC);
+    if (g_writer_doorbell_fd < 0)
+    {
+        fprintf(stderr, "Failed to create writer doorbell.\n");
+        return -1;
+    }
+    g_writer_thread_running = true;
+    int ret = pthread_create(&g_writer_thread, NULL, writer_thread_func, NULL);
+    if (ret != 0)
+    {
+        g_writer_thread_running = false;
+        close(g_writer_doorbell_fd);
+        g_writer_doorbell_fd = -1;
+    }
+    return ret;
+}
+
+void release_log_resources()
+{
+    stop_log_writer_thread();
+    pthread_mutex_destroy(&g_log_buf_mutex);
+    pthread_mutex_destroy(&g_log_write_mutex);
+    pthread_mutex_destroy(&g_module_list_mutex);
+    pthread_cond_destroy(&g_log_space_cond);
+
+    free_log_arena();
+    log_uring_exit(&g_log_uring);
+    if (g_log_spill_fd >= 0)
+    {
+        close(g_log_spill_fd);
+        g_log_spill_fd = -1;
+    }
+    free(g_log_buffer.staging[0]);
+    free(g_log_compress.hist);
+    free(g_log_compress.hash);
+    free(g_log_compress.out[0]);
+    g_log_compress = (log_compress_t){.enabled = false};
+    module_info_t *p = g_module_list_head;
+    while (p != NULL)
+    {
+        module_info_t *tmp = p;
+        p = p->next;
+        free(tmp);
+    }
+    module_slots_t *slots = atomic_load_explicit(&g_module_table.slots, memory_order_relaxed);
+    while (slots != NULL)
+    {
+        module_slots_t *retired = slots->retired;
+        free(slots);
+        slots = retired;
+    }
+    atomic_store_explicit(&g_module_table.slots, NULL, memory_order_relaxed);
+    g_module_table.used = 0;
+}
+
+#ifdef LOG_RING_BENCH
+#define BENCH_TOTAL_ENTRIES 100000
+#define BENCH_MAX_PRODUCERS 32
+#define BENCH_ENTRY_TEXT "ring buffer benchmark entry"
+
+static int g_bench_per_thread = 0;
+static bool g_bench_by_handle = false;
+
+static void *bench_producer(void *arg)
+{
+    char module_name[32];
+    snprintf(module_name, sizeof(module_name), "bench%ld", (long)(intptr_t)arg);
+    if (g_bench_by_handle)
+    {
+        int handle = bootlog_register_module(module_name, NULL);
+        for (int i = 0; i < g_bench_per_thread; i++)
+        {
+            print_to_log_buffer_by_handle(handle, BENCH_ENTRY_TEXT);
+        }
+        return NULL;
+    }
+    for (int i = 0; i < g_bench_per_thread; i++)
+    {
+        print_to_log_buffer(module_name, NULL, BENCH_ENTRY_TEXT);
+    }
+    return NULL;
+}
+
+// n个生产者共写入BENCH_TOTAL_ENTRIES条，返回每条的纳秒数
+static double bench_ring_round(int n, size_t record_size, FILE *null_file)
+{
+    pthread_t tids[BENCH_MAX_PRODUCERS];
+    struct timespec beg, end;
+    g_bench_per_thread = BENCH_TOTAL_ENTRIES / n;
+    clock_gettime(CLOCK_MONOTONIC, &beg);
+    for (long i = 0; i < n; i++)
+    {
+        pthread_create(&tids[i], NULL, bench_producer, (void *)(intptr_t)i);
+    }
+    for (int i = 0; i < n; i++)
+    {
+        pthread_join(tids[i], NULL);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double ns = (end.tv_sec - beg.tv_sec) * 1e9 + (end.tv_nsec - beg.tv_nsec);
+    size_t done = get_log_buffer_used() / record_size;
+    write_log_content_to_file(null_file);
+    return ns / done;
+}
+
+// 1~32个生产者并发写入同一环形缓冲区的吞吐量，分别按模块名和按模块句柄打印
+static void run_ring_bench()
+{
+    FILE *null_file = fopen("/dev/null", "w");
+    size_t record_size = LOG_RECORD_SIZE(strlen(BENCH_ENTRY_TEXT));
+    size_t bytes = BENCH_TOTAL_ENTRIES * record_size;
+    if (null_file == NULL || init_log_buffer(bytes, "/dev/null", bytes) != 0)
+    {
+        fprintf(stderr, "Failed to initialize benchmark.\n");
+        exit(EXIT_FAILURE);
+    }
+    printf("%zu bytes per record, %zu records per MB\n", record_size, (size_t)(1 << 20) / record_size);
+    printf("%-10s%-14s%-14s%-14s%-14s\n", "producers", "name/s", "name ns", "handle/s", "handle ns");
+    for (int n = 1; n <= BENCH_MAX_PRODUCERS; n *= 2)
+    {
+        g_bench_by_handle = false;
+        double name_ns = bench_ring_round(n, record_size, null_file);
+        g_bench_by_handle = true;
+        double handle_ns = bench_ring_round(n, record_size, null_file);
+        printf("%-10d%-14.0f%-14.1f%-14.0f%-14.1f\n", n, 1e9 / name_ns, name_ns, 1e9 / handle_ns, handle_ns);
+    }
+    fclose(null_file);
+    release_log_resources();
+}
+#endif
+
+#ifdef LOG_FLUSH_BENCH
+#define BENCH_FLUSH_ENTRIES 10000
+#define BENCH_FLUSH_ROUNDS 20
+#define BENCH_FLUSH_TEXT "flush path benchmark entry with a typical length of sixty bytes"
+
+static ssize_t bench_cookie_write(void *cookie, const char *buf, size_t len)
+{
+    atomic_fetch_add_explicit(&g_log_write_syscalls, 1, memory_order_relaxed);
+    return write(*(int *)cookie, buf, len);
+}
+
+// 原先逐条fprintf的写文件方式，作为对照
+static void bench_fprintf_flush(FILE *file)
+{
+    size_t pos = atomic_load(&g_log_buffer.ring->read_index);
+    log_entry_t *e = (log_entry_t *)(g_log_buffer.arena + pos % g_log_buffer.capacity);
+    uint32_t size;
+    while ((size = atomic_load(&e->size)) != 0 && !(size & LOG_RECORD_BUSY))
+    {
+        if (!(size & LOG_RECORD_PAD))
+        {
+            char timestr[20];
+            struct tm tm_now;
+            strftime(timestr, sizeof(timestr), "%Y-%m-%d %H:%M:%S", localtime_r(&e->timestamp, &tm_now));
+            char elapsed[24];
+            elapsed[format_log_elapsed(elapsed, log_entry_elapsed_ns(e))] = '\0';
+            fprintf(file, "[%s][%s][%s]%.*s\n", timestr, e->module->module_name, elapsed, e->log_len, e->log_content);
+        }
+        size &= ~LOG_RECORD_PAD;
+        memset(e, 0, size);
+        pos += size;
+        e = (log_entry_t *)(g_log_buffer.arena + pos % g_log_buffer.capacity);
+    }
+    atomic_store(&g_log_buffer.ring->read_index, pos);
+    fflush(file);
+}
+
+static void bench_fill_buffer()
+{
+    char module_name[32];
+    for (int i = 0; i < BENCH_FLUSH_ENTRIES; i++)
+    {
+        snprintf(module_name, sizeof(module_name), "module%d", i % 50);
+        print_to_log_buffer(module_name, NULL, BENCH_FLUSH_TEXT);
+    }
+}
+
+// 每1万条日志的写文件吞吐量、write系统调用次数，以及开启压缩后写出的字节数占原文的比例
+static void run_flush_bench()
+{
+    int null_fd = open("/dev/null", O_WRONLY);
+    cookie_io_functions_t io = {.write = bench_cookie_write};
+    FILE *legacy_file = fopencookie(&null_fd, "w", io);
+    FILE *batch_file = fdopen(null_fd, "w");
+    size_t record_size = LOG_RECORD_SIZE(strlen(BENCH_FLUSH_TEXT));
+    size_t arena_bytes = BENCH_FLUSH_ENTRIES * record_size;
+    if (legacy_file == NULL || batch_file == NULL || init_log_buffer(arena_bytes, "/dev/null", arena_bytes) != 0)
+    {
+        fprintf(stderr, "Failed to initialize benchmark.\n");
+        exit(EXIT_FAILURE);
+    }
+    printf("write backend: %s\n", get_log_backend_name());
+    printf("%-10s%-12s%-20s%-10s\n", "path", "MB/s", "syscalls/10k", "out/in");
+    static const char *paths[] = {"fprintf", "batched", "lz"};
+    for (int mode = 0; mode < 3; mode++)
+    {
+        if (mode == 2 && set_log_compression(true) != 0)
+        {
+            break;
+        }
+        double ns = 0, bytes = 0;
+        atomic_store(&g_log_write_syscalls, 0);
+        for (int r = 0; r < BENCH_FLUSH_ROUNDS; r++)
+        {
+            struct timespec beg, end;
+            bench_fill_buffer();
+            for (size_t off = 0; off < arena_bytes; off += record_size)
+            {
+                bytes += render_log_entry(g_log_buffer.staging[0], (log_entry_t *)(g_log_buffer.arena + off));
+            }
+            clock_gettime(CLOCK_MONOTONIC, &beg);
+            mode == 0 ? bench_fprintf_flush(legacy_file) : write_log_content_to_file(batch_file);
+            wait_log_write_complete();
+            clock_gettime(CLOCK_MONOTONIC, &end);
+            ns += (end.tv_sec - beg.tv_sec) * 1e9 + (end.tv_nsec - beg.tv_nsec);
+        }
+        printf("%-10s%-12.1f%-20.1f%-10.3f\n", paths[mode], bytes / ns * 1e3,
+               (double)atomic_load(&g_log_write_syscalls) / BENCH_FLUSH_ROUNDS,
+               mode == 2 ? (double)g_log_compress.out_bytes / g_log_compress.raw_bytes : 1.0);
+    }
+    fclose(legacy_file);
+    fclose(batch_file);
+    release_log_resources();
+}
+#endif
+
+#ifdef LOG_MODULE_BENCH
+#define BENCH_LOOKUPS 1000000
+
+// 原先逐个strcmp的线性查找，作为对照
+static module_info_t *bench_linear_find(const char *module_name)
+{
+    for (module_info_t *p = g_module_list_head; p != NULL; p = p->next)
+    {
+        if (strcmp(p->module_name, module_name) == 0)
+        {
+            return p;
+        }
+    }
+    return NULL;
+}
+
+// 10/100/1000个模块时每次模块查找的耗时
+static void run_module_bench()
+{
+    static const int module_nums[] = {10, 100, 1000};
+    char(*names)[32] = malloc(1000 * sizeof(*names));
+    volatile uintptr_t sink = 0;
+    for (int i = 0; i < 1000; i++)
+    {
+        snprintf(names[i], sizeof(names[i]), "boot_module_%d", i);
+    }
+    printf("%-10s%-14s%-14s\n", "modules", "linear ns", "hash ns");
+    for (size_t k = 0; k < sizeof(module_nums) / sizeof(module_nums[0]); k++)
+    {
+        int n = module_nums[k];
+        for (int i = 0; i < n; i++)
+        {
+            find_or_add_module_info(names[i], NULL);
+        }
+        double ns[2];
+        for (int mode = 0; mode < 2; mode++)
+        {
+            struct timespec beg, end;
+            clock_gettime(CLOCK_MONOTONIC, &beg);
+            for (int i = 0; i < BENCH_LOOKUPS; i++)
+            {
+                const char *name = names[((size_t)i * 7919) % n];
+                sink += (uintptr_t)(mode == 0 ? bench_linear_find(name) : find_or_add_module_info(name, NULL));
+            }
+            clock_gettime(CLOCK_MONOTONIC, &end);
+            ns[mode] = ((end.tv_sec - beg.tv_sec) * 1e9 + (end.tv_nsec - beg.tv_nsec)) / BENCH_LOOKUPS;
+        }
+        printf("%-10d%-14.1f%-14.1f\n", n, ns[0], ns[1]);
+    }
+    free(names);
+    release_log_resources();
+}
+#endif
+
+int main()
+{
+#ifdef LOG_RING_BENCH
+    run_ring_bench();
+    return 0;
+#endif
+#ifdef LOG_FLUSH_BENCH
+    run_flush_bench();
+    return 0;
+#endif
+#ifdef LOG_MODULE_BENCH
+    run_module_bench();
+    return 0;
+#endif
+
+    if (init_log_buffer(DEFAULT_LOG_BUFFER_CAPACITY, DEFAULT_LOG_FILE_PATH, DEFAULT_LOG_FLUSH_THRESHOLD) != 0)
+    {
+        fprintf(stderr, "Failed to initialize log buffer.\n");
+        exit(EXIT_FAILURE);
+    }
+    printf("log write backend: %s\n", get_log_backend_name());
     if (start_log_writer_thread() != 0)
     {
         fprintf(stderr, "Failed to start log writer thread.\n");
@@ -365,6 +2641,9 @@ int main()
     print_to_log_buffer("Module C", "dddd", "This is a log entry of Module C.");
     print_to_log_buffer("Module A", "Module B,Module D", "The last log entry of Module A.");
 
+    int module_e = bootlog_register_module("Module E", "Module A");
+    print_to_log_buffer_by_handle(module_e, "This is a log entry of Module E.");
+
     release_log_resources();
 
     return 0;